@@ -0,0 +1,449 @@
+// blockcomp.cc
+//	The second tier of the basic block engine: compiling hot blocks.
+//
+//	Threaded code (see blocksim.cc) still does all the book-keeping
+//	of the interpreter after every instruction: the delayed load
+//	registers are shuffled, the three PC registers are advanced, and
+//	the clock is ticked.  Nothing inside a basic block can observe
+//	most of that, though -- only the kernel can, and only when an
+//	instruction traps to it.  So, once a block has been run often
+//	enough to be worth the trouble, we translate it again into a
+//	list of micro-operations that skip the book-keeping:
+//
+//	   - the PCs and the clock are only brought up to date before
+//	     an instruction that might trap (a load or store, an add
+//	     that can overflow, a syscall, ...);
+//
+//	   - a load whose value isn't touched by the next instruction
+//	     (the usual case: that's what compilers fill load delay slots
+//	     with) writes its register immediately, rather than through
+//	     LoadReg and LoadValueReg;
+//
+//	   - instructions that write register 0 are dropped, and the
+//	     operands of the rest are picked out once, at compile time.
+//
+//	Anything out of the ordinary is run by its basic block engine
+//	handler instead, with the machine state fully up to date, so
+//	compiled code behaves exactly like the interpreter, down to the
+//	tick at which each exception or interrupt happens.
+//
+//	A block is always entered at the top, with the full block able
+//	to run before the next interrupt (RunBlocks checks this); the
+//	first instruction is run normally, since it may have to finish
+//	a delayed load started by the previous block, and so is the
+//	last one, since it is usually a branch.
+//
+//	If a page of code keeps being overwritten, we stop compiling it
+//	(see MaxCodeFlushes), and leave it to the basic block engine.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "mipssim.h"
+#include "system.h"
+
+#define MinCompiledLength 3	// shorter blocks aren't worth compiling
+
+//----------------------------------------------------------------------
+// Micro-op handlers
+// 	Operations that cannot trap use only the registers; they never
+//	leave the block.  Loads and stores are MicroPrecise, so if they
+//	trap, the PCs and the clock are already right for the kernel.
+//----------------------------------------------------------------------
+
+static bool
+DoSlow(Machine *m, MicroOp *op)
+{ return (*op->threaded->handler)(m, &op->threaded->instr); }
+
+#define ALU_OP(name, expr)				\
+static bool						\
+name(Machine *m, MicroOp *op)				\
+{							\
+    int *r = m->registers;				\
+							\
+    r[op->rd] = (expr);					\
+    return TRUE;					\
+}
+
+ALU_OP(DoMove, r[op->rs])
+ALU_OP(DoLoadImm, op->extra)
+ALU_OP(DoAddImm, r[op->rs] + op->extra)
+ALU_OP(DoAdd, r[op->rs] + r[op->rt])
+ALU_OP(DoSub, r[op->rs] - r[op->rt])
+ALU_OP(DoAnd, r[op->rs] & r[op->rt])
+ALU_OP(DoAndImm, r[op->rs] & op->extra)
+ALU_OP(DoOrImm, r[op->rs] | op->extra)
+ALU_OP(DoXor, r[op->rs] ^ r[op->rt])
+ALU_OP(DoXorImm, r[op->rs] ^ op->extra)
+ALU_OP(DoNor, ~(r[op->rs] | r[op->rt]))
+ALU_OP(DoShiftLeft, r[op->rt] << op->extra)
+ALU_OP(DoShiftRight, r[op->rt] >> op->extra)	// signed for SRL too,
+ALU_OP(DoShiftLeftV, r[op->rt] << (r[op->rs] & 0x1f)) // like the
+ALU_OP(DoShiftRightV, r[op->rt] >> (r[op->rs] & 0x1f)) // interpreter
+ALU_OP(DoSetLess, (r[op->rs] < r[op->rt]) ? 1 : 0)
+ALU_OP(DoSetLessImm, (r[op->rs] < op->extra) ? 1 : 0)
+ALU_OP(DoSetLessU, ((unsigned int) r[op->rs] < (unsigned int) r[op->rt])
+								? 1 : 0)
+ALU_OP(DoSetLessImmU, ((unsigned int) r[op->rs] < (unsigned int) op->extra)
+								? 1 : 0)
+
+static bool
+DoLoadWord(Machine *m, MicroOp *op)
+{
+    int addr = m->registers[op->rs] + op->extra;
+    int value;
+
+    if (addr & 0x3) {
+	m->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!m->ReadMem(addr, 4, &value))
+	return FALSE;
+    m->registers[op->rt] = value;
+    return TRUE;
+}
+
+static bool
+DoLoadByte(Machine *m, MicroOp *op)
+{
+    int value;
+
+    if (!m->ReadMem(m->registers[op->rs] + op->extra, 1, &value))
+	return FALSE;
+    if (value & 0x80)
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    m->registers[op->rt] = value;
+    return TRUE;
+}
+
+static bool
+DoLoadByteU(Machine *m, MicroOp *op)
+{
+    int value;
+
+    if (!m->ReadMem(m->registers[op->rs] + op->extra, 1, &value))
+	return FALSE;
+    m->registers[op->rt] = value & 0xff;
+    return TRUE;
+}
+
+static bool
+DoStoreWord(Machine *m, MicroOp *op)
+{
+    return m->WriteMem((unsigned) (m->registers[op->rs] + op->extra), 4,
+			m->registers[op->rt]);
+}
+
+static bool
+DoStoreByte(Machine *m, MicroOp *op)
+{
+    return m->WriteMem((unsigned) (m->registers[op->rs] + op->extra), 1,
+			m->registers[op->rt]);
+}
+
+//----------------------------------------------------------------------
+// IsLoad
+// 	Return TRUE if an instruction starts a delayed load.
+//----------------------------------------------------------------------
+
+static bool
+IsLoad(int opCode)
+{
+    switch (opCode) {
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU:
+      case OP_LW: case OP_LWL: case OP_LWR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// IsStore
+// 	Return TRUE if an instruction writes memory.
+//----------------------------------------------------------------------
+
+static bool
+IsStore(int opCode)
+{
+    switch (opCode) {
+      case OP_SB: case OP_SH: case OP_SW: case OP_SWL: case OP_SWR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// MayTouch
+// 	Return TRUE if an instruction might read or write register "reg".
+//	Conservative: any register field that matches counts, even if
+//	the instruction format doesn't use that field.
+//----------------------------------------------------------------------
+
+static bool
+MayTouch(Instruction *instr, int reg)
+{
+    if (instr->rs == reg || instr->rt == reg || instr->rd == reg)
+	return TRUE;
+    switch (instr->opCode) {
+      case OP_JAL: case OP_BGEZAL: case OP_BLTZAL:
+	return (reg == R31);
+      case OP_SYSCALL: case OP_RES: case OP_UNIMP:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// FastHandlerFor
+// 	Fill in a micro-op for an instruction that can be run without
+//	its basic block engine handler.  Return FALSE if it can't.
+//----------------------------------------------------------------------
+
+static bool
+FastHandlerFor(Instruction *instr, MicroOp *op)
+{
+    op->rd = instr->rd;
+    op->rs = instr->rs;
+    op->rt = instr->rt;
+    op->extra = instr->extra;
+
+    switch (instr->opCode) {
+      case OP_ADDIU:
+	op->rd = instr->rt;
+	if (instr->rs == 0)
+	    op->handler = DoLoadImm;
+	else if (instr->extra == 0)
+	    op->handler = DoMove;
+	else
+	    op->handler = DoAddImm;
+	break;
+      case OP_ADDU:
+	if (instr->rt == 0)
+	    op->handler = DoMove;
+	else
+	    op->handler = DoAdd;
+	break;
+      case OP_OR:			// really rs | rs; see mipssim.cc
+	op->handler = DoMove;
+	break;
+      case OP_SUBU:	op->handler = DoSub; break;
+      case OP_AND:	op->handler = DoAnd; break;
+      case OP_XOR:	op->handler = DoXor; break;
+      case OP_NOR:	op->handler = DoNor; break;
+      case OP_SLL:	op->handler = DoShiftLeft; break;
+      case OP_SRA:
+      case OP_SRL:	op->handler = DoShiftRight; break;
+      case OP_SLLV:	op->handler = DoShiftLeftV; break;
+      case OP_SRAV:
+      case OP_SRLV:	op->handler = DoShiftRightV; break;
+      case OP_SLT:	op->handler = DoSetLess; break;
+      case OP_SLTU:	op->handler = DoSetLessU; break;
+      case OP_MFHI:
+	op->rs = HiReg;
+	op->handler = DoMove;
+	break;
+      case OP_MFLO:
+	op->rs = LoReg;
+	op->handler = DoMove;
+	break;
+      case OP_ANDI:
+      case OP_ORI:
+      case OP_XORI:
+	op->rd = instr->rt;
+	op->extra = instr->extra & 0xffff;
+	if (instr->opCode == OP_ANDI)
+	    op->handler = DoAndImm;
+	else if (instr->opCode == OP_ORI)
+	    op->handler = DoOrImm;
+	else
+	    op->handler = DoXorImm;
+	break;
+      case OP_LUI:
+	op->rd = instr->rt;
+	op->extra = instr->extra << 16;
+	op->handler = DoLoadImm;
+	break;
+      case OP_SLTI:
+	op->rd = instr->rt;
+	op->handler = DoSetLessImm;
+	break;
+      case OP_SLTIU:
+	op->rd = instr->rt;
+	op->handler = DoSetLessImmU;
+	break;
+      case OP_LW:
+	op->handler = DoLoadWord;
+	op->flags = MicroPrecise;
+	break;
+      case OP_LB:
+	op->handler = DoLoadByte;
+	op->flags = MicroPrecise;
+	break;
+      case OP_LBU:
+	op->handler = DoLoadByteU;
+	op->flags = MicroPrecise;
+	break;
+      case OP_SW:
+	op->handler = DoStoreWord;
+	op->flags = MicroPrecise | MicroStore;
+	break;
+      case OP_SB:
+	op->handler = DoStoreByte;
+	op->flags = MicroPrecise | MicroStore;
+	break;
+      default:
+	return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CompileBlock
+// 	Translate a basic block of threaded code into micro-ops.
+//	Returns NULL if the block is too short to be worth it.
+//
+//	"head" -- threaded code for the first instruction of the block
+//	"length" -- the number of instructions in the block
+//----------------------------------------------------------------------
+
+CompiledBlock *
+Machine::CompileBlock(ThreadedOp *head, int length)
+{
+    CompiledBlock *block;
+    MicroOp *op;
+    Instruction *instr;
+    bool slow, pending = FALSE;	// is a delayed load in progress?
+    int k;
+
+    if (length < MinCompiledLength)
+	return NULL;
+    block = new CompiledBlock;
+    block->ops = new MicroOp[length];
+    op = block->ops;
+    for (k = 0; k < length; k++) {
+	instr = &head[k].instr;
+	op->flags = 0;
+	op->offset = k * 4;
+	op->threaded = &head[k];
+
+	// a delayed load in progress must be finished by the interpreter,
+	// as must a load whose value the next instruction might see
+	slow = (k == 0) || (k == length - 1) || pending;
+	if (!slow && IsLoad(instr->opCode) && (instr->rt == 0
+			|| MayTouch(&head[k + 1].instr, instr->rt)))
+	    slow = TRUE;
+	if (slow || !FastHandlerFor(instr, op)) {
+	    op->handler = DoSlow;
+	    op->flags = MicroSlow;
+	    if (k > 0)
+		op->flags |= MicroPrecise;
+	    if (IsStore(instr->opCode))
+		op->flags |= MicroStore;
+	    pending = IsLoad(instr->opCode);
+	} else {
+	    pending = FALSE;
+	    if (!(op->flags & MicroPrecise) && op->rd == 0)
+		continue;		// no effect; don't keep it
+	}
+	op++;
+    }
+    block->numOps = op - block->ops;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunCompiled
+// 	Run a compiled block, from its first instruction.  On return,
+//	the PCs and the clock are as Machine::RunBlocks would have left
+//	them: everything up to date, except the clock is not ticked
+//	for the last instruction run.
+//
+//	"block" -- the compiled block
+//----------------------------------------------------------------------
+
+void
+Machine::RunCompiled(CompiledBlock *block)
+{
+    MicroOp *op = block->ops, *end = block->ops + block->numOps;
+    int startPC = registers[PCReg];
+    int startTicks = stats->totalTicks, startUserTicks = stats->userTicks;
+    int ticks;
+
+    char flags;
+
+    codeChanged = FALSE;
+    for (; op < end; op++) {
+	flags = op->flags;		// the store may free the block
+	if (flags & MicroPrecise) {
+	    registers[PrevPCReg] = startPC + op->offset - 4;
+	    registers[PCReg] = startPC + op->offset;
+	    registers[NextPCReg] = startPC + op->offset + 4;
+	    ticks = (op->offset / 4) * UserTick;
+	    stats->totalTicks = startTicks + ticks;
+	    stats->userTicks = startUserTicks + ticks;
+	}
+	if (!(*op->handler)(this, op))
+	    return;			// trapped to the kernel
+	if ((flags & MicroStore) && codeChanged) {
+	    if (!(flags & MicroSlow)) {		// finish the store
+		registers[PrevPCReg] = registers[PCReg];
+		registers[PCReg] = registers[NextPCReg];
+		registers[NextPCReg] += 4;
+	    }
+	    return;			// we may have changed our own code
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::FreeCompiledCode
+// 	Throw away the compiled blocks of a physical page, because its
+//	threaded code is about to be rebuilt, or we're shutting down.
+//	Returns TRUE if there were any.
+//
+//	"physPage" -- the physical page
+//----------------------------------------------------------------------
+
+bool
+Machine::FreeCompiledCode(int physPage)
+{
+    ThreadedOp *ops = threadedPages[physPage];
+    bool found = FALSE;
+
+    if (ops == NULL)
+	return FALSE;
+    for (int i = 0; i < InstrsPerPage; i++)
+	if (FreeCompiledBlock(&ops[i]))
+	    found = TRUE;
+    return found;
+}
+
+//----------------------------------------------------------------------
+// Machine::FreeCompiledBlock
+// 	Throw away the compiled form of one block, if it has one.
+//	Returns TRUE if it did.
+//
+//	"head" -- the threaded code for the first instruction of the block
+//----------------------------------------------------------------------
+
+bool
+Machine::FreeCompiledBlock(ThreadedOp *head)
+{
+    if (head->compiled == NULL)
+	return FALSE;
+    delete [] head->compiled->ops;
+    delete head->compiled;
+    head->compiled = NULL;
+    return TRUE;
+}
@@ -0,0 +1,640 @@
+// blocksim.cc
+//	A faster way of running user programs: the basic block engine.
+//
+//	Machine::Run normally fetches, decodes and dispatches every
+//	instruction, and then calls Interrupt::OneTick to advance the
+//	clock and look for interrupts that are due.  Here, instead,
+//	each physical page of code is translated once into "threaded
+//	code" -- an array of (handler, decoded instruction) pairs -- and
+//	straight-line runs of code up to the next branch, jump or
+//	syscall are executed by calling the handlers back to back.
+//
+//	Simulated time is charged for a whole block at once, and pending
+//	interrupts are only checked at the end of a block -- or earlier,
+//	if the next interrupt is due before the block would finish.
+//	Since nothing can fire in between, the result is exactly the
+//	same as running the block one instruction at a time: the same
+//	register and memory contents, the same exceptions, and the same
+//	interrupts at the same ticks.
+//
+//	The common instructions get their own handlers below; the rest
+//	are passed to Machine::ExecuteInstruction, so that there is only
+//	one definition of what they do.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "machine.h"
+#include "mipssim.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Retire
+// 	Finish executing an instruction: do any delayed load, and
+//	advance the program counters.  Same as the end of
+//	Machine::ExecuteInstruction.
+//
+//	"loadReg", "loadValue" -- the delayed load started by this
+//		instruction, if any
+//	"pcAfter" -- where to go after the next instruction
+//----------------------------------------------------------------------
+
+static inline bool
+Retire(int *r, int loadReg, int loadValue, int pcAfter)
+{
+    r[r[LoadReg]] = r[LoadValueReg];
+    r[LoadReg] = loadReg;
+    r[LoadValueReg] = loadValue;
+    r[0] = 0;
+    r[PrevPCReg] = r[PCReg];
+    r[PCReg] = r[NextPCReg];
+    r[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Op handlers
+// 	One routine per common opcode.  Each must behave exactly like
+//	the corresponding case in Machine::ExecuteInstruction.
+//----------------------------------------------------------------------
+
+static bool
+DoGeneric(Machine *m, Instruction *i)
+{ return m->ExecuteInstruction(i); }
+
+static bool
+DoADDIU(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rt] = r[i->rs] + i->extra;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoADDU(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[i->rs] + r[i->rt];
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSUBU(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[i->rs] - r[i->rt];
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoAND(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[i->rs] & r[i->rt];
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoANDI(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rt] = r[i->rs] & (i->extra & 0xffff);
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoORI(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rt] = r[i->rs] | (i->extra & 0xffff);
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoXOR(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[i->rs] ^ r[i->rt];
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoXORI(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rt] = r[i->rs] ^ (i->extra & 0xffff);
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoNOR(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = ~(r[i->rs] | r[i->rt]);
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoLUI(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rt] = i->extra << 16;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSLL(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[i->rt] << i->extra;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSRA(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[i->rt] >> i->extra;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSRL(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int tmp = r[i->rt];		// signed, just like the interpreter
+
+    tmp >>= i->extra;
+    r[i->rd] = tmp;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSLT(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = (r[i->rs] < r[i->rt]) ? 1 : 0;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSLTI(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rt] = (r[i->rs] < i->extra) ? 1 : 0;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSLTU(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = ((unsigned int) r[i->rs] < (unsigned int) r[i->rt]) ? 1 : 0;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSLTIU(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rt] = ((unsigned int) r[i->rs] < (unsigned int) i->extra) ? 1 : 0;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoMFHI(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[HiReg];
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoMFLO(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[LoReg];
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoLW(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int addr = r[i->rs] + i->extra;
+    int value;
+
+    if (addr & 0x3) {
+	m->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!m->ReadMem(addr, 4, &value))
+	return FALSE;
+    return Retire(r, i->rt, value, r[NextPCReg] + 4);
+}
+
+static bool
+DoLB(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int value;
+
+    if (!m->ReadMem(r[i->rs] + i->extra, 1, &value))
+	return FALSE;
+    if (value & 0x80)
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    return Retire(r, i->rt, value, r[NextPCReg] + 4);
+}
+
+static bool
+DoLBU(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int value;
+
+    if (!m->ReadMem(r[i->rs] + i->extra, 1, &value))
+	return FALSE;
+    return Retire(r, i->rt, value & 0xff, r[NextPCReg] + 4);
+}
+
+static bool
+DoSW(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    if (!m->WriteMem((unsigned) (r[i->rs] + i->extra), 4, r[i->rt]))
+	return FALSE;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoSB(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    if (!m->WriteMem((unsigned) (r[i->rs] + i->extra), 1, r[i->rt]))
+	return FALSE;
+    return Retire(r, 0, 0, r[NextPCReg] + 4);
+}
+
+static bool
+DoBEQ(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[i->rs] == r[i->rt])
+	pcAfter = r[NextPCReg] + IndexToAddr(i->extra);
+    return Retire(r, 0, 0, pcAfter);
+}
+
+static bool
+DoBNE(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[i->rs] != r[i->rt])
+	pcAfter = r[NextPCReg] + IndexToAddr(i->extra);
+    return Retire(r, 0, 0, pcAfter);
+}
+
+static bool
+DoBLEZ(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[i->rs] <= 0)
+	pcAfter = r[NextPCReg] + IndexToAddr(i->extra);
+    return Retire(r, 0, 0, pcAfter);
+}
+
+static bool
+DoBGTZ(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[i->rs] > 0)
+	pcAfter = r[NextPCReg] + IndexToAddr(i->extra);
+    return Retire(r, 0, 0, pcAfter);
+}
+
+static bool
+DoBLTZ(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (r[i->rs] & SIGN_BIT)
+	pcAfter = r[NextPCReg] + IndexToAddr(i->extra);
+    return Retire(r, 0, 0, pcAfter);
+}
+
+static bool
+DoBGEZ(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    if (!(r[i->rs] & SIGN_BIT))
+	pcAfter = r[NextPCReg] + IndexToAddr(i->extra);
+    return Retire(r, 0, 0, pcAfter);
+}
+
+static bool
+DoJ(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    return Retire(r, 0, 0, (pcAfter & 0xf0000000) | IndexToAddr(i->extra));
+}
+
+static bool
+DoJAL(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+    int pcAfter = r[NextPCReg] + 4;
+
+    r[R31] = r[NextPCReg] + 4;
+    return Retire(r, 0, 0, (pcAfter & 0xf0000000) | IndexToAddr(i->extra));
+}
+
+static bool
+DoJR(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    return Retire(r, 0, 0, r[i->rs]);
+}
+
+static bool
+DoJALR(Machine *m, Instruction *i)
+{
+    int *r = m->registers;
+
+    r[i->rd] = r[NextPCReg] + 4;
+    return Retire(r, 0, 0, r[i->rs]);
+}
+
+//----------------------------------------------------------------------
+// HandlerFor
+// 	Return the handler routine for an opcode.
+//----------------------------------------------------------------------
+
+static OpHandler
+HandlerFor(int opCode)
+{
+    switch (opCode) {
+      case OP_ADDIU:	return DoADDIU;
+      case OP_ADDU:	return DoADDU;
+      case OP_SUBU:	return DoSUBU;
+      case OP_AND:	return DoAND;
+      case OP_ANDI:	return DoANDI;
+      case OP_ORI:	return DoORI;
+      case OP_XOR:	return DoXOR;
+      case OP_XORI:	return DoXORI;
+      case OP_NOR:	return DoNOR;
+      case OP_LUI:	return DoLUI;
+      case OP_SLL:	return DoSLL;
+      case OP_SRA:	return DoSRA;
+      case OP_SRL:	return DoSRL;
+      case OP_SLT:	return DoSLT;
+      case OP_SLTI:	return DoSLTI;
+      case OP_SLTU:	return DoSLTU;
+      case OP_SLTIU:	return DoSLTIU;
+      case OP_MFHI:	return DoMFHI;
+      case OP_MFLO:	return DoMFLO;
+      case OP_LW:	return DoLW;
+      case OP_LB:	return DoLB;
+      case OP_LBU:	return DoLBU;
+      case OP_SW:	return DoSW;
+      case OP_SB:	return DoSB;
+      case OP_BEQ:	return DoBEQ;
+      case OP_BNE:	return DoBNE;
+      case OP_BLEZ:	return DoBLEZ;
+      case OP_BGTZ:	return DoBGTZ;
+      case OP_BLTZ:	return DoBLTZ;
+      case OP_BGEZ:	return DoBGEZ;
+      case OP_J:	return DoJ;
+      case OP_JAL:	return DoJAL;
+      case OP_JR:	return DoJR;
+      case OP_JALR:	return DoJALR;
+      default:		return DoGeneric;
+    }
+}
+
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Return TRUE if an instruction can transfer control somewhere
+//	other than the next word -- a branch, jump, syscall, or an
+//	instruction that always traps.  These end a basic block.
+//----------------------------------------------------------------------
+
+static bool
+EndsBlock(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BGTZ:
+      case OP_BLTZ: case OP_BGEZ: case OP_BLTZAL: case OP_BGEZAL:
+      case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+      case OP_SYSCALL: case OP_RES: case OP_UNIMP:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchBlock
+// 	Return the threaded code for the basic block that starts at
+//	"physAddr".  The first time we run code from a physical page,
+//	the whole page is translated; block boundaries are worked out
+//	lazily, the first time each block is entered.
+//
+//	A block never crosses a page boundary, since the next page
+//	might not be contiguous in virtual memory.
+//
+//	"physAddr" -- word-aligned physical address of the first instruction
+//	"length" -- set to the number of instructions in the block
+//----------------------------------------------------------------------
+
+ThreadedOp *
+Machine::FetchBlock(int physAddr, int *length)
+{
+    int page = physAddr >> PageShift;
+    int first = (physAddr & (PageSize - 1)) / 4;
+    ThreadedOp *ops = threadedPages[page];
+    int i;
+
+    if (!pageThreaded[page]) {
+	if (ops == NULL) {
+	    ops = new ThreadedOp[InstrsPerPage];
+	    threadedPages[page] = ops;
+	} else if (FreeCompiledCode(page))
+	    codeFlushes[page]++;	// code we compiled was overwritten
+	for (i = 0; i < InstrsPerPage; i++) {
+	    ops[i].instr = *FetchDecoded(page * PageSize + i * 4);
+	    ops[i].handler = HandlerFor(ops[i].instr.opCode);
+	    ops[i].blockLength = 0;
+	    ops[i].hits = 0;
+	    ops[i].compiled = NULL;
+	}
+	pageThreaded[page] = TRUE;
+    }
+    if (ops[first].blockLength == 0) {
+	for (i = first; i < InstrsPerPage - 1; i++)
+	    if (EndsBlock(ops[i].instr.opCode))
+		break;
+	ops[first].blockLength = i - first + 1;
+    }
+    *length = ops[first].blockLength;
+    return &ops[first];
+}
+
+//----------------------------------------------------------------------
+// Machine::RethreadWord
+// 	A store has changed an instruction word on a page of threaded
+//	code.  Translate it again, and forget what we know of the blocks
+//	that contain it: those that start at it, or at any instruction
+//	before it back to the last one that ends a block.
+//
+//	If any of those blocks was compiled, the program is changing its
+//	own code; count it, so that we give up compiling the page if it
+//	keeps doing so.  If any has been run, set "codeChanged", so that
+//	the engine stops running the current block, which may be one of
+//	them, once the store is done.
+//
+//	"physAddr" -- physical address of (any byte of) the word
+//----------------------------------------------------------------------
+
+void
+Machine::RethreadWord(int physAddr)
+{
+    int page = physAddr >> PageShift;
+    int word = (physAddr & (PageSize - 1)) / 4;
+    ThreadedOp *ops = threadedPages[page];
+    bool flushed = FALSE;
+
+    ops[word].instr = decodedPages[page][word];
+    ops[word].handler = HandlerFor(ops[word].instr.opCode);
+    for (int i = word; i >= 0; i--) {
+	if (i < word && EndsBlock(ops[i].instr.opCode))
+	    break;			// blocks before here end by here
+	if (ops[i].blockLength != 0)
+	    codeChanged = TRUE;
+	if (FreeCompiledBlock(&ops[i]))
+	    flushed = TRUE;
+	ops[i].blockLength = 0;
+	ops[i].hits = 0;
+    }
+    if (flushed)
+	codeFlushes[page]++;		// compiled code was overwritten
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Simulate the execution of a user program, one basic block at
+//	a time.  Called by Machine::Run; never returns.
+//
+//	Each time around the loop, we look up the block at the PC and
+//	work out how many of its instructions can run before the next
+//	pending interrupt is due.  Time is charged as each instruction
+//	starts, so that if one traps to the kernel, the kernel sees the
+//	same clock as it would have under Machine::Run.  The last
+//	instruction is charged by Interrupt::OneTick, which also fires
+//	anything that has become due.
+//
+//	A block is cut short if an instruction traps to the kernel (the
+//	kernel may have changed the registers, or scheduled new
+//	interrupts), or if it changed code that has been run (see
+//	RethreadWord), which may be its own.
+//
+//	With the CompileEngine, a block that has been run
+//	HotBlockThreshold times is compiled, and from then on its
+//	compiled form is run instead, whenever the whole block can run.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    int physAddr, page, length, due, budget, i;
+    ExceptionType exception;
+    ThreadedOp *op;
+
+    for (;;) {
+	exception = QuickTranslate(registers[PCReg], &physAddr, 4, FALSE);
+	if (exception != NoException) {
+	    RaiseException(exception, registers[PCReg]);
+	    interrupt->OneTick();
+	    continue;
+	}
+	op = FetchBlock(physAddr, &length);
+	page = physAddr >> PageShift;
+
+	// an instruction in a branch delay slot is followed by the
+	// branch target, not the next word
+	if (registers[NextPCReg] != registers[PCReg] + 4)
+	    length = 1;
+
+	// stop at the tick the next interrupt is due, if that's sooner
+	due = interrupt->NextDueTime();
+	if (due >= 0) {
+	    budget = divRoundUp(due - stats->totalTicks, UserTick);
+	    if (budget < 1)
+		budget = 1;
+	    length = min(length, budget);
+	}
+
+	// if the whole block will run, and it is hot, use compiled code
+	if (engine == CompileEngine && length == op->blockLength
+		&& registers[NextPCReg] == registers[PCReg] + 4) {
+	    if (op->compiled == NULL && ++op->hits == HotBlockThreshold
+		    && codeFlushes[page] < MaxCodeFlushes)
+		op->compiled = CompileBlock(op, length);
+	    if (op->compiled != NULL) {
+		RunCompiled(op->compiled);
+		interrupt->OneTick();
+		continue;
+	    }
+	}
+
+	codeChanged = FALSE;
+	for (i = 0; i < length; i++, op++) {
+	    if (i > 0) {			// charge for the previous one
+		stats->totalTicks += UserTick;
+		stats->userTicks += UserTick;
+	    }
+	    if (!(*op->handler)(this, &op->instr) || codeChanged)
+		break;
+	}
+	interrupt->OneTick();
+    }
+}
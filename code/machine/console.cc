@@ -22,6 +22,8 @@ static void ConsoleReadPoll(int c)
 { Console *console = (Console *)c; console->CheckCharAvail(); }
 static void ConsoleWriteDone(int c)
 { Console *console = (Console *)c; console->WriteDone(); }
+static void ConsoleInputReady(int c)
+{ Console *console = (Console *)c; console->InputReady(); }
 
 //----------------------------------------------------------------------
 // Console::Console
@@ -55,8 +57,8 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
     putBusy = FALSE;
     incoming = EOF;
 
-    // start polling for incoming packets
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, ConsoleReadInt);
+    // start waiting for the first character to be typed
+    WaitForInput();
 }
 
 //----------------------------------------------------------------------
@@ -66,21 +68,49 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
 
 Console::~Console()
 {
+    IgnoreFile(readFileNo);
     if (readFileNo != 0)
 	Close(readFileNo);
     if (writeFileNo != 1)
 	Close(writeFileNo);
 }
 
+//----------------------------------------------------------------------
+// Console::WaitForInput()
+// 	Ask to be told when the next character is typed.  Rather than 
+//	checking the keyboard every so often, we have the host tell us
+//	(see Interrupt::WatchInput).
+//----------------------------------------------------------------------
+
+void
+Console::WaitForInput()
+{
+    interrupt->WatchInput(readFileNo, ConsoleInputReady, (int)this);
+}
+
+//----------------------------------------------------------------------
+// Console::InputReady()
+// 	Called when the host has a character for us.  The simulated
+//	keyboard takes ConsoleTime to deliver it.
+//----------------------------------------------------------------------
+
+void
+Console::InputReady()
+{
+    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
+			ConsoleReadInt);
+}
+
 //----------------------------------------------------------------------
 // Console::CheckCharAvail()
-// 	Periodically called to check if a character is available for
-//	input from the simulated keyboard (eg, has it been typed?).
+// 	Called to check if a character is available for input from the
+//	simulated keyboard (eg, has it been typed?), once the host says
+//	it is.
 //
 //	Only read it in if there is buffer space for it (if the previous
-//	character has been grabbed out of the buffer by the Nachos kernel).
-//	Invoke the "read" interrupt handler, once the character has been 
-//	put into the buffer. 
+//	character has been grabbed out of the buffer by the Nachos kernel);
+//	GetChar waits for the next one once it has been.  Invoke the "read"
+//	interrupt handler, once the character has been put into the buffer. 
 //----------------------------------------------------------------------
 
 void
@@ -88,13 +118,13 @@ Console::CheckCharAvail()
 {
     char c;
 
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
-			ConsoleReadInt);
-
-    // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
-	return;	  
+    // do nothing if character is already buffered
+    if (incoming != EOF)
+	return;
+    if (!PollFile(readFileNo)) {	// someone else got there first
+	WaitForInput();
+	return;
+    }
 
     // otherwise, read character and tell user about it
     Read(readFileNo, &c, sizeof(char));
@@ -121,7 +151,8 @@ Console::WriteDone()
 //----------------------------------------------------------------------
 // Console::GetChar()
 // 	Read a character from the input buffer, if there is any there.
-//	Either return the character, or EOF if none buffered.
+//	Either return the character, or EOF if none buffered.  Once
+//	the buffer is free, wait for the next character.
 //----------------------------------------------------------------------
 
 char
@@ -130,6 +161,8 @@ Console::GetChar()
    char ch = incoming;
 
    incoming = EOF;
+   if (ch != EOF)
+	WaitForInput();
    return ch;
 }
 
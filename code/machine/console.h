@@ -55,6 +55,7 @@ class Console {
 // internal emulation routines -- DO NOT call these. 
     void WriteDone();	 	// internal routines to signal I/O completion
     void CheckCharAvail();
+    void InputReady();		// the host has a character for us
 
   private:
     int readFileNo;			// UNIX file emulating the keyboard 
@@ -70,6 +71,9 @@ class Console {
     char incoming;    			// Contains the character to be read,
 					// if there is one available. 
 					// Otherwise contains EOF.
+
+    void WaitForInput();		// Ask the host to tell us when a
+					// character is typed
 };
 
 #endif // CONSOLE_H
@@ -14,6 +14,13 @@
 //		a user instruction is executed
 //		there is nothing in the ready queue
 //
+//	When the machine has several CPUs, they take turns ("slices")
+//	of a few ticks each.  Each round of turns covers the same span of
+//	simulated time: after one CPU has run its slice, the clock is
+//	wound back to the start of the round for the next one, so that
+//	in the end all of them run during the same ticks.  Interrupts
+//	are taken by whichever CPU gets to them first.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -28,7 +35,22 @@
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv", "IPI"};
+
+//----------------------------------------------------------------------
+// CurrentCPU
+// 	Return the CPU we are simulating right now.
+//----------------------------------------------------------------------
+
+static int
+CurrentCPU()
+{
+#ifdef USER_PROGRAM
+    if (machine != NULL)
+	return machine->CurrentCPU();
+#endif
+    return 0;
+}
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -48,6 +70,228 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     arg = param;
     when = time;
     type = kind;
+    order = 0;
+    position = -1;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::EventQueue
+// 	Initialize an empty queue of pending interrupts.  The heap grows
+//	as needed.
+//----------------------------------------------------------------------
+
+EventQueue::EventQueue()
+{
+    heapSize = 16;
+    heap = new PendingInterrupt *[heapSize];
+    numEvents = 0;
+    nextOrder = 0;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::~EventQueue
+// 	De-allocate the queue, and any interrupts still on it.
+//----------------------------------------------------------------------
+
+EventQueue::~EventQueue()
+{
+    for (int i = 0; i < numEvents; i++)
+	delete heap[i];
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Before
+// 	Return TRUE if interrupt "a" should fire before "b": it is due
+//	sooner, or at the same time, but was scheduled first.  (The
+//	order numbers may wrap around; that is fine, as long as there
+//	aren't 2^31 interrupts pending at once.)
+//----------------------------------------------------------------------
+
+bool
+EventQueue::Before(PendingInterrupt *a, PendingInterrupt *b)
+{
+    if (a->when != b->when)
+	return (a->when < b->when);
+    return ((int) (a->order - b->order) < 0);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Place
+// 	Put an interrupt in a slot of the heap, and remember where.
+//----------------------------------------------------------------------
+
+void
+EventQueue::Place(PendingInterrupt *event, int i)
+{
+    heap[i] = event;
+    event->position = i;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::SiftUp, SiftDown
+// 	Move the interrupt in heap[i] up towards the top, or down towards
+//	the bottom, until the heap is in order again.
+//----------------------------------------------------------------------
+
+void
+EventQueue::SiftUp(int i)
+{
+    PendingInterrupt *event = heap[i];
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(event, heap[parent]))
+	    break;
+	Place(heap[parent], i);
+	i = parent;
+    }
+    Place(event, i);
+}
+
+void
+EventQueue::SiftDown(int i)
+{
+    PendingInterrupt *event = heap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < numEvents) {
+	if (child + 1 < numEvents && Before(heap[child + 1], heap[child]))
+	    child++;			// the sooner of the two children
+	if (!Before(heap[child], event))
+	    break;
+	Place(heap[child], i);
+	i = child;
+    }
+    Place(event, i);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Insert
+// 	Put an interrupt on the queue.
+//
+//	"event" is the interrupt; it must not be on a queue already
+//----------------------------------------------------------------------
+
+void
+EventQueue::Insert(PendingInterrupt *event)
+{
+    ASSERT(event->position == -1);
+    if (numEvents == heapSize) {		// out of room; double it
+	PendingInterrupt **bigger = new PendingInterrupt *[heapSize * 2];
+
+	for (int i = 0; i < numEvents; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	heapSize *= 2;
+    }
+    event->order = nextOrder++;
+    Place(event, numEvents++);
+    SiftUp(event->position);
+}
+
+//----------------------------------------------------------------------
+// EventQueue::RemoveFirst
+// 	Take the interrupt that is due first off the queue.
+//
+// Returns:
+//	The interrupt, or NULL if the queue is empty
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+EventQueue::RemoveFirst()
+{
+    PendingInterrupt *first = Peek();
+
+    if (first != NULL)
+	(void) Remove(first);
+    return first;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Remove
+// 	Take an interrupt off the queue, wherever it is.  The last
+//	interrupt in the heap takes its place, and is moved up or down
+//	to where it belongs.
+//
+// Returns:
+//	FALSE if the interrupt was not on the queue
+//
+//	"event" is the interrupt to take off
+//----------------------------------------------------------------------
+
+bool
+EventQueue::Remove(PendingInterrupt *event)
+{
+    int i = event->position;
+
+    if (i < 0 || i >= numEvents || heap[i] != event)
+	return FALSE;
+    event->position = -1;
+    numEvents--;
+    if (i < numEvents) {
+	Place(heap[numEvents], i);
+	SiftUp(i);
+	SiftDown(heap[i]->position);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Move
+// 	Change when an interrupt on the queue is due, and move it up or
+//	down to where it now belongs.  Among interrupts due at the same
+//	time, it goes after those already there, as if it had just been
+//	inserted.
+//
+// Returns:
+//	FALSE if the interrupt was not on the queue
+//
+//	"event" is the interrupt to move
+//	"when" is the time it is now due
+//----------------------------------------------------------------------
+
+bool
+EventQueue::Move(PendingInterrupt *event, int when)
+{
+    int i = event->position;
+
+    if (i < 0 || i >= numEvents || heap[i] != event)
+	return FALSE;
+    event->when = when;
+    event->order = nextOrder++;
+    SiftUp(i);
+    SiftDown(event->position);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// EventQueue::Mapcar
+// 	Apply a function to each interrupt on the queue, in the order
+//	they will fire.  Sorts a copy of the heap, so it is slow; for 
+//	debugging.
+//
+//	"func" is the procedure to apply to each interrupt
+//----------------------------------------------------------------------
+
+void
+EventQueue::Mapcar(VoidFunctionPtr func)
+{
+    PendingInterrupt **sorted = new PendingInterrupt *[numEvents + 1];
+    PendingInterrupt *event;
+    int i, j;
+
+    for (i = 0; i < numEvents; i++) {		// insertion sort
+	event = heap[i];
+	for (j = i; j > 0 && Before(event, sorted[j - 1]); j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = event;
+    }
+    for (i = 0; i < numEvents; i++)
+	(*func)((int) sorted[i]);
+    delete [] sorted;
 }
 
 //----------------------------------------------------------------------
@@ -60,10 +304,23 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new EventQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    for (int i = 0; i < MaxCPUs; i++) {
+	inUserCode[i] = FALSE;
+	aheadTicks[i] = 0;
+	cpuTimerDue[i] = -1;
+    }
+    cpuTimerHandler = NULL;
+    cpuTimerArg = 0;
+    numIPIs = 0;
+    sliceTicks = 0;
+    sliceEnd = -1;
+    roundStart = -1;
+    nextCheck = 0;			// nothing known yet
+    nextPoll = 0;
 }
 
 //----------------------------------------------------------------------
@@ -73,9 +330,11 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
     delete pending;
+    for (int i = 0; i < MaxCPUs; i++) {
+	while (!ipis[i].IsEmpty())
+	    delete ipis[i].Remove();
+    }
 }
 
 //----------------------------------------------------------------------
@@ -146,6 +405,10 @@ Interrupt::Enable()
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	Usually, nothing is due for a long time, so we keep track of
+//	when something next might be (nextCheck), and if it isn't time
+//	yet, just advance the clock.
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
@@ -160,14 +423,22 @@ Interrupt::OneTick()
 	stats->totalTicks += UserTick;
 	stats->userTicks += UserTick;
     }
+    if (stats->totalTicks < nextCheck)	// nothing can be due yet
+	return;
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
 					// interrupts disabled)
+    if (stats->totalTicks >= nextPoll && FilesWatched() > 0)
+	PollInput(FALSE);		// check for input from the host
     while (CheckIfDue(FALSE))		// check for pending interrupts
 	;
+    if (sliceTicks > 0)			// and this CPU's own timer
+	(void) CheckCPUTimer(CurrentCPU());
+    if (numIPIs > 0)			// and for IPIs to this CPU
+	DeliverIPIs(CurrentCPU());
     ChangeLevel(IntOff, IntOn);		// re-enable interrupts
     if (yieldOnReturn) {		// if the timer device handler asked 
 					// for a context switch, ok to do it now
@@ -176,6 +447,98 @@ Interrupt::OneTick()
 	currentThread->Yield();
 	status = old;
     }
+#ifdef USER_PROGRAM
+    while (sliceTicks > 0 && stats->totalTicks >= sliceEnd) {
+	int cpu, ahead;
+
+	ChangeLevel(IntOn, IntOff);	// this CPU's turn is over; let
+	status = SystemMode;		// the kernel run the next one
+	inUserCode[CurrentCPU()] = (old == UserMode);
+	scheduler->NextCPU();
+	cpu = CurrentCPU();		// our turn again; if we were run 
+	inUserCode[cpu] = FALSE;	// ahead, catch up with ourselves
+	ahead = aheadTicks[cpu];
+	aheadTicks[cpu] = 0;
+	status = old;
+	ChangeLevel(IntOff, IntOn);
+	stats->totalTicks += ahead;
+	stats->userTicks += ahead;
+    }
+#endif
+    UpdateNextCheck();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::UpdateNextCheck
+// 	Work out the first tick at which OneTick will have something to
+//	do: when the next interrupt is due, the current CPU's turn is
+//	over or its timer goes off, or it is time to check for input.  If there are IPIs to
+//	deliver, or a thread to yield, or we are printing every tick,
+//	that is right away.  Called whenever any of these change.
+//----------------------------------------------------------------------
+
+void
+Interrupt::UpdateNextCheck()
+{
+    PendingInterrupt *next = pending->Peek();
+
+    if (yieldOnReturn || numIPIs > 0 || DebugIsEnabled('i')) {
+	nextCheck = 0;
+	return;
+    }
+    nextCheck = (next == NULL) ? 0x7fffffff : next->when;
+    if (sliceTicks > 0) {
+	int timerDue = cpuTimerDue[CurrentCPU()];
+
+	if (sliceEnd < nextCheck)
+	    nextCheck = sliceEnd;
+	if (timerDue >= 0 && timerDue < nextCheck)
+	    nextCheck = timerDue;
+    }
+    if (FilesWatched() > 0 && nextPoll < nextCheck)
+	nextCheck = nextPoll;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::WatchInput
+// 	Called by a hardware device simulator, to be told (by calling
+//	"handler") when the host has input for it -- a key pressed, a
+//	packet arrived.  It is told only once; to hear about the next
+//	input, it must call again.
+//
+//	While there is anything else to do, we check for input every
+//	PollTime ticks; when Nachos is idle, we wait for it.
+//
+//	"fd" -- the host file to watch
+//	"handler" -- the function to call when it has input
+//	"arg" -- the argument to pass to it
+//----------------------------------------------------------------------
+
+void
+Interrupt::WatchInput(int fd, VoidFunctionPtr handler, int arg)
+{
+    if (FilesWatched() == 0)
+	nextPoll = stats->totalTicks + PollTime;
+    WatchFile(fd, handler, arg);
+    if (FilesWatched() > 0 && nextPoll < nextCheck)
+	nextCheck = nextPoll;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::PollInput
+// 	Call the handlers of any devices whose input has arrived, and 
+//	start the wait for the next check.
+//
+//	"wait" -- if TRUE, there is nothing else to do, so wait for
+//		the input to arrive
+//----------------------------------------------------------------------
+
+void
+Interrupt::PollInput(bool wait)
+{
+    DEBUG('i', "Checking for input%s\n", wait ? ", waiting for it" : "");
+    PollFiles(wait);
+    nextPoll = stats->totalTicks + PollTime;
 }
 
 //----------------------------------------------------------------------
@@ -194,6 +557,7 @@ Interrupt::YieldOnReturn()
 { 
     ASSERT(inHandler == TRUE);  
     yieldOnReturn = TRUE; 
+    nextCheck = 0;
 }
 
 //----------------------------------------------------------------------
@@ -205,26 +569,44 @@ Interrupt::YieldOnReturn()
 //	simulated time until the next scheduled hardware interrupt.
 //
 //	If there are no pending interrupts, stop.  There's nothing
-//	more for us to do.
+//	more for us to do.  The same goes if the only one is the timer, 
+//	since all it does is take the CPU from a running thread.
 //----------------------------------------------------------------------
 void
 Interrupt::Idle()
 {
+    PendingInterrupt *next;
+
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
-    if (CheckIfDue(TRUE)) {		// check for any pending interrupts
+    roundStart = -1;			// the clock is about to jump
+    if (FilesWatched() > 0) {		// if the console or network is
+	next = pending->Peek();		// waiting for input, and there's
+					// nothing else coming but time 
+					// slices, wait for it
+	PollInput(next == NULL || (next->type == TimerInt
+				   && pending->NumEvents() == 1));
+    }
+    next = pending->Peek();
+    if (FilesWatched() == 0 && next != NULL && next->type == TimerInt
+				&& pending->NumEvents() == 1)
+	next = NULL;			// only time slices are left to come,
+					// and they can't wake anyone
+    if (next != NULL && CheckIfDue(TRUE)) { // check for any pending 
+					// interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
         yieldOnReturn = FALSE;		// since there's nothing in the
 					// ready queue, the yield is automatic
         status = SystemMode;
+	UpdateNextCheck();
 	return;				// return in case there's now
 					// a runnable thread
     }
 
     // if there are no pending interrupts, and nothing is on the ready
     // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
+    // operating, we *always* wait for input above, so this code
     // is not reached.  Instead, the halt must be invoked by the user program.
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
@@ -235,13 +617,17 @@ Interrupt::Idle()
 
 //----------------------------------------------------------------------
 // Interrupt::Halt
-// 	Shut down Nachos cleanly, printing out performance statistics.
+// 	Shut down Nachos cleanly, printing out performance statistics,
+//	and the time accounting of each thread left.
 //----------------------------------------------------------------------
 void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+    if (replayLog != NULL)
+	replayLog->Print();
+    Ts();
     Cleanup();     // Never returns.
 }
 
@@ -250,18 +636,22 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it on the event queue.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
 //
+// Returns:
+//	A handle for cancelling the interrupt.  It is only good until
+//	the interrupt occurs, or is cancelled.
+//
 //	"handler" is the procedure to call when the interrupt occurs
 //	"arg" is the argument to pass to the procedure
 //	"fromNow" is how far in the future (in simulated time) the 
 //		 interrupt is to occur
 //	"type" is the hardware device that generated the interrupt
 //----------------------------------------------------------------------
-void
+PendingInterrupt *
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
@@ -271,7 +661,295 @@ Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur);
+    if (when < nextCheck)
+	nextCheck = when;
+    return toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Cancel
+// 	Take back an interrupt scheduled by Schedule, before it occurs.
+//
+// Returns:
+//	FALSE if it was no longer pending
+//
+//	"toCancel" is the handle returned by Schedule
+//----------------------------------------------------------------------
+
+bool
+Interrupt::Cancel(PendingInterrupt *toCancel)
+{
+    if (!pending->Remove(toCancel))
+	return FALSE;
+    DEBUG('i', "Cancelling interrupt handler the %s at time = %d\n", 
+				intTypeNames[toCancel->type], toCancel->when);
+    delete toCancel;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Reschedule
+// 	Move an interrupt scheduled by Schedule, that hasn't occurred
+//	yet, to occur "fromNow" instead.  The same as cancelling it and
+//	scheduling it again, but cheaper.
+//
+// Returns:
+//	FALSE if it was no longer pending
+//
+//	"toMove" is the handle returned by Schedule
+//	"fromNow" is how far in the future (in simulated time) the 
+//		 interrupt is now to occur
+//----------------------------------------------------------------------
+
+bool
+Interrupt::Reschedule(PendingInterrupt *toMove, int fromNow)
+{
+    int when = stats->totalTicks + fromNow;
+
+    ASSERT(fromNow > 0);
+    if (!pending->Move(toMove, when))
+	return FALSE;
+    DEBUG('i', "Rescheduling interrupt handler the %s at time = %d\n", 
+					intTypeNames[toMove->type], when);
+    if (when < nextCheck)
+	nextCheck = when;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextDueTime
+// 	Return the simulated time at which the earliest pending interrupt
+//	is due, without firing it.  Lets the machine simulation run 
+//	several user instructions between checks, as long as it stops
+//	by this time.
+//
+// Returns:
+//	The tick of the next pending interrupt, -1 if nothing is pending.
+//----------------------------------------------------------------------
+
+int
+Interrupt::NextDueTime()
+{
+    PendingInterrupt *next = pending->Peek();
+    int when = (next == NULL) ? -1 : next->when;
+
+    if (sliceTicks > 0) {		// also stop at the end of our turn,
+	int cpu = CurrentCPU();		// or when our timer goes off
+
+	if (!ipis[cpu].IsEmpty())
+	    return stats->totalTicks;
+	if (when < 0 || sliceEnd < when)
+	    when = sliceEnd;
+	if (cpuTimerDue[cpu] >= 0 && cpuTimerDue[cpu] < when)
+	    when = cpuTimerDue[cpu];
+    }
+    return when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SendIPI
+// 	Send an inter-processor interrupt to a CPU.  The handler is 
+//	called on that CPU (in other words, with that CPU's thread as
+//	currentThread) at the end of the next tick it runs -- which is
+//	this one, if the IPI is to ourselves.  As with other interrupts,
+//	the handler is called with interrupts disabled, and can ask for
+//	a context switch with YieldOnReturn.
+//
+//	"cpu" is the CPU to interrupt
+//	"handler" is the procedure to call on that CPU
+//	"arg" is the argument to pass to the procedure
+//----------------------------------------------------------------------
+
+void
+Interrupt::SendIPI(int cpu, VoidFunctionPtr handler, int arg)
+{
+    ASSERT(cpu >= 0 && cpu < MaxCPUs);
+    DEBUG('i', "Sending IPI to CPU %d at time = %d\n", cpu, 
+					stats->totalTicks);
+    ipis[cpu].Append(new PendingInterrupt(handler, arg, 
+					stats->totalTicks, IPIInt));
+    numIPIs++;
+    nextCheck = 0;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::DeliverIPIs
+// 	Call the handlers for all the IPIs sent to a CPU, in the order
+//	they were sent.  Interrupts must already be disabled.
+//
+//	"cpu" is the CPU we are running on
+//----------------------------------------------------------------------
+
+void
+Interrupt::DeliverIPIs(int cpu)
+{
+    MachineStatus old = status;
+    PendingInterrupt *ipi;
+
+    ASSERT(level == IntOff);
+    while ((ipi = ipis[cpu].Remove()) != NULL) {
+	DEBUG('i', "Invoking IPI handler on CPU %d at time %d\n", cpu,
+			stats->totalTicks);
+#ifdef USER_PROGRAM
+	if (machine != NULL)
+	    machine->DelayedLoad(0, 0);
+#endif
+	inHandler = TRUE;
+	status = SystemMode;
+	numIPIs--;
+	(*(ipi->handler))(ipi->arg);
+	status = old;
+	inHandler = FALSE;
+	delete ipi;
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SetCPUTimer
+// 	With several CPUs, each has a timer of its own, so that the
+//	quantum of the thread on one isn't cut short (or stretched) by
+//	the threads on the others.  Arrange for the current CPU's timer
+//	to go off "fromNow" ticks into that CPU's own time, and not before;
+//	if it was going to go off at some other time, it no longer will.
+//	Since the clock is wound back at the start of each CPU's turn,
+//	only the current CPU's timer is checked, in OneTick.
+//
+//	"handler" is the procedure to call, when the timer goes off
+//	"arg" is the argument to pass to it
+//	"fromNow" is how long from now it is to go off
+//----------------------------------------------------------------------
+
+void
+Interrupt::SetCPUTimer(VoidFunctionPtr handler, int arg, int fromNow)
+{
+    int cpu = CurrentCPU();
+
+    ASSERT(sliceTicks > 0 && fromNow > 0);
+    DEBUG('i', "Setting the timer of CPU %d for time = %d\n", cpu,
+					stats->totalTicks + fromNow);
+    cpuTimerHandler = handler;
+    cpuTimerArg = arg;
+    cpuTimerDue[cpu] = stats->totalTicks + fromNow;
+    if (cpuTimerDue[cpu] < nextCheck)
+	nextCheck = cpuTimerDue[cpu];
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckCPUTimer
+// 	If the timer of "cpu" is due, call its handler, as CheckIfDue 
+//	would.  Interrupts must already be disabled.
+//
+//	"cpu" is the CPU we are running on
+//
+// Returns:
+//	TRUE, if the handler was called
+//----------------------------------------------------------------------
+
+bool
+Interrupt::CheckCPUTimer(int cpu)
+{
+    MachineStatus old = status;
+
+    ASSERT(level == IntOff);
+    if (cpuTimerDue[cpu] < 0 || cpuTimerDue[cpu] > stats->totalTicks)
+	return FALSE;
+    cpuTimerDue[cpu] = -1;
+    if (replayLog != NULL)		// log it, or check it was logged
+	replayLog->Interrupted(TimerInt);
+
+    DEBUG('i', "Invoking the timer handler of CPU %d at time %d\n", cpu,
+			stats->totalTicks);
+#ifdef USER_PROGRAM
+    if (machine != NULL)
+	machine->DelayedLoad(0, 0);
+#endif
+    inHandler = TRUE;
+    status = SystemMode;
+    (*cpuTimerHandler)(cpuTimerArg);
+    status = old;
+    inHandler = FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::StartCPUSlices
+// 	Start interleaving the CPUs of a multiprocessor.  Each runs for
+//	"ticks" of simulated time, then the kernel switches to the next
+//	one (Scheduler::NextCPU), which runs over the same ticks again.
+//
+//	"ticks" is the length of each CPU's turn
+//----------------------------------------------------------------------
+
+void
+Interrupt::StartCPUSlices(int ticks)
+{
+    ASSERT(ticks > 0);
+    sliceTicks = ticks;
+    roundStart = stats->totalTicks;
+    sliceEnd = roundStart + sliceTicks;
+    UpdateNextCheck();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextSlice
+// 	Start another CPU's turn.  If it is the next CPU in the same
+//	round, wind the clock back to the start of the round; otherwise,
+//	start a new round now.  Called by the kernel, when it switches
+//	CPUs.
+//
+//	"sameRound" is TRUE if the next CPU hasn't yet had its turn
+//		during this round
+//----------------------------------------------------------------------
+
+void
+Interrupt::NextSlice(bool sameRound)
+{
+    if (sameRound && roundStart >= 0)
+	stats->totalTicks = roundStart;
+    else {
+	roundStart = stats->totalTicks;
+	RunAhead();
+    }
+    sliceEnd = roundStart + sliceTicks;
+    UpdateNextCheck();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RunAhead
+// 	At the start of a round, run the CPUs that are in the middle of 
+//	user code ahead on host threads, if the machine is set up to (see
+//	parallel.cc).  Each can run until the end of its turn, but not
+//	up to the next pending interrupt: that has to be fired, from
+//	OneTick, in the proper order.  (A CPU whose own timer goes off
+//	during its turn doesn't run ahead at all.)  A CPU that has run
+//	ahead catches up with itself in OneTick, when its turn comes.
+//----------------------------------------------------------------------
+
+void
+Interrupt::RunAhead()
+{
+#ifdef USER_PROGRAM
+    bool eligible[MaxCPUs];
+    int done[MaxCPUs];
+    int limit, cpu;
+    PendingInterrupt *next;
+
+    if (machine == NULL)
+	return;
+    limit = divRoundUp(sliceTicks, UserTick);
+    if ((next = pending->Peek()) != NULL 
+			&& next->when <= roundStart + limit * UserTick)
+	limit = (next->when - roundStart - 1) / UserTick;
+    for (cpu = 0; cpu < machine->NumCPUs(); cpu++)
+	eligible[cpu] = inUserCode[cpu] && ipis[cpu].IsEmpty()
+		&& (cpuTimerDue[cpu] < 0 
+		    || cpuTimerDue[cpu] > roundStart + limit * UserTick);
+    if (!machine->RunAhead(eligible, limit, done))
+	return;
+    for (cpu = 0; cpu < machine->NumCPUs(); cpu++)
+	aheadTicks[cpu] = done[cpu] * UserTick;
+#endif
 }
 
 //----------------------------------------------------------------------
@@ -297,26 +975,25 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = pending->Peek();
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks)	// not time yet, leave it
 	return FALSE;
-    }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& pending->NumEvents() == 1)
 	 return FALSE;
-    }
+    (void) pending->RemoveFirst();
+    if (replayLog != NULL)		// log it, or check it was logged
+	replayLog->Interrupted(toOccur->type);
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -36,7 +36,7 @@
 #define INTERRUPT_H
 
 #include "copyright.h"
-#include "list.h"
+#include "ilist.h"
 
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
 enum IntStatus { IntOff, IntOn };
@@ -49,8 +49,12 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
 // display and keyboard, and a network.
+// An IPIInt is an inter-processor interrupt, sent by the kernel
+// running on one CPU to another.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+				NetworkSendInt, NetworkRecvInt, IPIInt};
+
+#define MaxCPUs		16	// most CPUs we can send IPIs to
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -67,6 +71,51 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+
+    unsigned int order;		// when it was scheduled, to break ties 
+    int position;		// where it is in the EventQueue, or -1
+    ListLink<PendingInterrupt> link; // for the IPIs waiting for a CPU
+};
+
+// The following class defines the queue of interrupts scheduled to
+// occur, as a binary heap ordered by when they are due -- and, among
+// those due at the same time, by the order they were scheduled in.
+// The next interrupt to fire is always at the top, and any pending 
+// interrupt can be taken out early (cancelled) in O(log n) time.
+
+class EventQueue {
+  public:
+    EventQueue();			// initialize an empty queue
+    ~EventQueue();			// de-allocate the queue, and
+					// anything left on it
+
+    void Insert(PendingInterrupt *event); // Put an interrupt on the queue
+    PendingInterrupt *Peek() { return (numEvents > 0) ? heap[0] : NULL; }
+					// The next interrupt due, if any
+    PendingInterrupt *RemoveFirst();	// Take the next one off the queue
+    bool Remove(PendingInterrupt *event); // Take any one off the queue;
+					// FALSE if it wasn't there
+    bool Move(PendingInterrupt *event, int when); // Make one due at
+					// "when"; FALSE if it wasn't there
+
+    bool IsEmpty() { return (numEvents == 0); }
+    int NumEvents() { return numEvents; }
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to each interrupt,
+					// in the order they are due
+
+  private:
+    PendingInterrupt **heap;	// heap[0] is due first; heap[i] is due
+				// no later than heap[2i+1] and heap[2i+2]
+    int numEvents;		// how many interrupts are in the heap
+    int heapSize;		// how many it has room for
+    unsigned int nextOrder;	// stamped on each interrupt inserted
+
+    bool Before(PendingInterrupt *a, PendingInterrupt *b);
+				// Is "a" due before "b"?
+    void Place(PendingInterrupt *event, int i);
+				// Put "event" in heap[i]
+    void SiftUp(int i);		// Restore the heap order, after heap[i]
+    void SiftDown(int i);	// moved up or down
 };
 
 // The following class defines the data structures for the simulation
@@ -96,35 +145,101 @@ class Interrupt {
 					// from an interrupt handler
 
     MachineStatus getStatus() { return status; } // idle, kernel, user
+    bool InHandler() { return inHandler; } // in an interrupt handler?
     void setStatus(MachineStatus st) { status = st; }
 
     void DumpState();			// Print interrupt state
     
+    void SendIPI(int cpu, VoidFunctionPtr handler, int arg);
+					// Interrupt another CPU; "handler"
+					// is called on that CPU, the next
+					// time it runs
 
     // NOTE: the following are internal to the hardware simulation code.
     // DO NOT call these directly.  I should make them "private",
     // but they need to be public since they are called by the
     // hardware device simulators.
 
-    void Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
-	int arg, int when, IntType type);// at time ``when''.  This is called
+    PendingInterrupt *Schedule(VoidFunctionPtr handler,
+	int arg, int when, IntType type);// Schedule an interrupt to occur
+					// at time ``when''.  This is called
     					// by the hardware device simulators.
+    bool Cancel(PendingInterrupt *toCancel);
+					// Take back a scheduled interrupt
+					// that hasn't occurred yet
+    bool Reschedule(PendingInterrupt *toMove, int fromNow);
+					// Move one to a new time
+    void WatchInput(int fd, VoidFunctionPtr handler, int arg);
+					// Call "handler" once the host has
+					// input for file "fd".  Also called
+					// by the device simulators.
     
     void OneTick();       		// Advance simulated time
 
+    int NextDueTime();			// When the next pending interrupt
+					// is scheduled to fire, -1 if none
+    int NextCheck() { return nextCheck; }
+					// The first tick at which OneTick
+					// has anything to do, other than 
+					// advance the clock
+
+    void StartCPUSlices(int ticks);	// Interleave several CPUs, giving
+					// each "ticks" of time in turn
+    void NextSlice(bool sameRound);	// Start the next CPU's turn, over
+					// the same ticks as the last one if
+					// "sameRound"
+    bool CPUTimers() { return (sliceTicks > 0); }
+					// Does each CPU have a timer of 
+					// its own?
+    void SetCPUTimer(VoidFunctionPtr handler, int arg, int fromNow);
+					// Call "handler" on the current CPU
+					// "fromNow" ticks into its own time,
+					// instead of whenever it was going to
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
+    EventQueue *pending;	// the interrupts scheduled
 				// to occur in the future
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    int nextCheck;		// see NextCheck; kept up to date by 
+				// UpdateNextCheck, and never later than
+				// it should be (earlier is harmless)
+    int nextPoll;		// when to next check the host for input,
+				// if we are watching for any
+
+    IList<PendingInterrupt> ipis[MaxCPUs]; // IPIs not yet delivered, 
+				// for each CPU
+    int numIPIs;		// how many there are, on all CPUs
+    int sliceTicks;		// how long each CPU runs before the next,
+				// or 0 if there is only one CPU
+    int sliceEnd;		// when the current CPU's turn is over
+    int roundStart;		// when the current round of turns started,
+				// or -1 if time jumped since then
+    bool inUserCode[MaxCPUs];	// is each CPU waiting for its turn in the
+				// middle of user code?
+    int aheadTicks[MaxCPUs];	// time each CPU has already run ahead,
+				// this round (see parallel.cc)
+    int cpuTimerDue[MaxCPUs];	// when each CPU's own timer goes off, 
+				// in its own time, or -1 if it isn't set
+    VoidFunctionPtr cpuTimerHandler; // what to call when one does
+    int cpuTimerArg;
 
     // these functions are internal to the interrupt simulation code
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void DeliverIPIs(int cpu);		// Call the handlers of any IPIs 
+					// sent to "cpu"
+    bool CheckCPUTimer(int cpu);	// Fire the timer of "cpu", if it
+					// is due
+    void RunAhead();			// Run CPUs ahead on host threads,
+					// at the start of a round
+    void UpdateNextCheck();		// Work out nextCheck again
+    void PollInput(bool wait);		// Check the host for input, waiting
+					// for some if "wait"
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
@@ -18,6 +18,36 @@ static char* exceptionNames[] = { "no exception", "syscall",
 				"bus error", "address error", "overflow",
 				"illegal instruction" };
 
+// The geometry of the simulated memory; see SetMemoryGeometry.
+int PageSize = DefaultPageSize;
+int PageShift;
+int NumPhysPages = DefaultNumPhysPages;
+int TLBSize = DefaultTLBSize;
+
+//----------------------------------------------------------------------
+// SetMemoryGeometry
+// 	Choose the size of the simulated machine's memory and TLB.
+//	Must be called before the Machine is created, and never after.
+//
+//	"numPages" -- the number of page frames in physical memory
+//	"pageSize" -- the number of bytes in a page; a power of 2
+//	"tlbSize" -- the number of entries in the TLB, if there is one
+//----------------------------------------------------------------------
+
+void
+SetMemoryGeometry(int numPages, int pageSize, int tlbSize)
+{
+    ASSERT(pageSize >= 4 && (pageSize & (pageSize - 1)) == 0);
+    ASSERT(numPages > 0 && numPages <= 0x7fffffff / pageSize);
+    ASSERT(tlbSize > 0);
+
+    PageSize = pageSize;
+    for (PageShift = 0; (1 << PageShift) < pageSize; PageShift++)
+	;
+    NumPhysPages = numPages;
+    TLBSize = tlbSize;
+}
+
 //----------------------------------------------------------------------
 // CheckEndian
 // 	Check to be sure that the host really uses the format it says it 
@@ -50,28 +80,67 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"engineType" -- how to execute user code: one instruction at a time, 
+//		a basic block at a time, or also compiling hot blocks.
+//	"cpuCount" -- the number of CPUs sharing main memory
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, EngineType engineType, int cpuCount)
 {
-    int i;
+    int i, cpu;
+    CPUState *state;
 
-    for (i = 0; i < NumTotalRegs; i++)
-        registers[i] = 0;
-    mainMemory = new char[MemorySize];
-    for (i = 0; i < MemorySize; i++)
-      	mainMemory[i] = 0;
+    if (PageShift == 0)		// nobody asked for anything special
+	SetMemoryGeometry(NumPhysPages, PageSize, TLBSize);
+    ASSERT(cpuCount > 0 && cpuCount <= MaxCPUs);
+    numCPUs = cpuCount;
+    cpus = new CPUState[numCPUs];
+    for (cpu = 0; cpu < numCPUs; cpu++) {
+	state = &cpus[cpu];
+	for (i = 0; i < NumTotalRegs; i++)
+	    state->registers[i] = 0;
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
+	state->tlb = new TranslationEntry[TLBSize];
+	for (i = 0; i < TLBSize; i++)
+	    state->tlb[i].valid = FALSE;
 #else	// use linear page table
-    tlb = NULL;
-    pageTable = NULL;
+	state->tlb = NULL;
 #endif
+	state->pageTable = NULL;
+	state->pageTableSize = 0;
+	state->softRead = new SoftTLBEntry[SoftTLBSize];
+	state->softWrite = new SoftTLBEntry[SoftTLBSize];
+	for (i = 0; i < SoftTLBSize; i++) {
+	    state->softRead[i].virtualPage = -1;
+	    state->softWrite[i].virtualPage = -1;
+	}
+	state->runUntilTime = 0;
+    }
+    currentCPU = 0;			// start out on CPU 0
+    LoadCPUState(&cpus[0]);
 
+    mainMemory = new char[MemorySize];
+    for (i = 0; i < MemorySize; i++)
+      	mainMemory[i] = 0;
+    decodedPages = new Instruction *[NumPhysPages];
+    pageDecoded = new bool[NumPhysPages];
+    threadedPages = new ThreadedOp *[NumPhysPages];
+    pageThreaded = new bool[NumPhysPages];
+    codeFlushes = new int[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++) {
+	decodedPages[i] = NULL;
+	pageDecoded[i] = FALSE;
+	threadedPages[i] = NULL;
+	pageThreaded[i] = FALSE;
+	codeFlushes[i] = 0;
+    }
+    codeChanged = FALSE;
     singleStep = debug;
+    engine = engineType;
+    parent = NULL;
+    views = NULL;
+    frameOwner = NULL;
+    hostThreads = 0;
     CheckEndian();
 }
 
@@ -82,9 +151,89 @@ Machine::Machine(bool debug)
 
 Machine::~Machine()
 {
+    if (parent != NULL)		// a view owns nothing
+	return;
+    if (views != NULL) {
+	for (int cpu = 0; cpu < numCPUs; cpu++)
+	    delete views[cpu];
+	delete [] views;
+	delete [] frameOwner;
+    }
     delete [] mainMemory;
-    if (tlb != NULL)
-        delete [] tlb;
+    for (int i = 0; i < NumPhysPages; i++) {
+	delete [] decodedPages[i];
+	(void) FreeCompiledCode(i);
+	delete [] threadedPages[i];
+    }
+    delete [] decodedPages;
+    delete [] pageDecoded;
+    delete [] threadedPages;
+    delete [] pageThreaded;
+    delete [] codeFlushes;
+    for (int cpu = 0; cpu < numCPUs; cpu++) {
+	if (cpus[cpu].tlb != NULL)
+	    delete [] cpus[cpu].tlb;
+	delete [] cpus[cpu].softRead;
+	delete [] cpus[cpu].softWrite;
+    }
+    delete [] cpus;
+}
+
+//----------------------------------------------------------------------
+// Machine::SwitchCPU
+// 	Start simulating a different CPU: save the registers, TLB, page
+//	table and so on of the current CPU, and load those of "cpu".
+//	Main memory is shared, so it stays as it is.
+//
+//	"cpu" -- the CPU to switch to
+//----------------------------------------------------------------------
+
+void
+Machine::SwitchCPU(int cpu)
+{
+    ASSERT(cpu >= 0 && cpu < numCPUs);
+    SaveCPUState();
+    currentCPU = cpu;
+    LoadCPUState(&cpus[cpu]);
+}
+
+//----------------------------------------------------------------------
+// Machine::SaveCPUState
+// 	Save the fields of the current CPU that the kernel may have
+//	changed into its CPUState.  (The registers are kept there all
+//	along.)
+//----------------------------------------------------------------------
+
+void
+Machine::SaveCPUState()
+{
+    CPUState *state = &cpus[currentCPU];
+
+    state->tlb = tlb;
+    state->pageTable = pageTable;
+    state->pageTableSize = pageTableSize;
+    state->softRead = softRead;
+    state->softWrite = softWrite;
+    state->runUntilTime = runUntilTime;
+}
+
+//----------------------------------------------------------------------
+// Machine::LoadCPUState
+// 	Make "state" the CPU seen through registers, tlb, and so on.
+//
+//	"state" -- the CPU to load
+//----------------------------------------------------------------------
+
+void
+Machine::LoadCPUState(CPUState *state)
+{
+    registers = state->registers;
+    tlb = state->tlb;
+    pageTable = state->pageTable;
+    pageTableSize = state->pageTableSize;
+    softRead = state->softRead;
+    softWrite = state->softWrite;
+    runUntilTime = state->runUntilTime;
 }
 
 //----------------------------------------------------------------------
@@ -100,6 +249,8 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    if (parent != NULL)			// running ahead on a host thread;
+	return;				// leave the trap to the kernel
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
@@ -107,6 +258,8 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
+    FlushSoftTLB();			// the kernel may have changed the 
+					// page table or TLB
     interrupt->setStatus(UserMode);
 }
 
@@ -165,7 +318,10 @@ Machine::DumpState()
 {
     int i;
     
-    printf("Machine registers:\n");
+    if (numCPUs > 1)
+	printf("Machine registers (CPU %d of %d):\n", currentCPU, numCPUs);
+    else
+	printf("Machine registers:\n");
     for (i = 0; i < NumGPRegs; i++)
 	switch (i) {
 	  case StackReg:
@@ -191,12 +347,18 @@ Machine::DumpState()
     printf("\tPrevPC:\t0x%x\n", registers[PrevPCReg]);
     printf("\tLoad:\t0x%x", registers[LoadReg]);
     printf("\tLoadV:\t0x%x\n", registers[LoadValueReg]);
-    printf("\n");
+    printf("\tMemory:\t%d pages of %d bytes", NumPhysPages, PageSize);
+    if (tlb != NULL)
+	printf("\tTLB:\t%d entries", TLBSize);
+    printf("\n\n");
 }
 
 //----------------------------------------------------------------------
 // Machine::ReadRegister/WriteRegister
-//   	Fetch or write the contents of a user program register.
+//   	Fetch or write the contents of a user program register.  A 
+//	register can also be read from a CPU other than the current one,
+//	so that the kernel can move a thread's registers from one CPU
+//	to another.
 //----------------------------------------------------------------------
 
 int Machine::ReadRegister(int num)
@@ -205,6 +367,13 @@ int Machine::ReadRegister(int num)
 	return registers[num];
     }
 
+int Machine::ReadRegister(int cpu, int num)
+    {
+	ASSERT((cpu >= 0) && (cpu < numCPUs));
+	ASSERT((num >= 0) && (num < NumTotalRegs));
+	return cpus[cpu].registers[num];
+    }
+
 void Machine::WriteRegister(int num, int value)
     {
 	ASSERT((num >= 0) && (num < NumTotalRegs));
@@ -27,14 +27,28 @@
 #include "disk.h"
 
 // Definitions related to the size, and format of user memory
+//
+// The size of physical memory, of a page, and of the TLB are chosen 
+// when Nachos starts up (see the -mem, -pagesize and -tlb flags in 
+// system.cc), and must not change once the Machine has been created.
 
-#define PageSize 	SectorSize 	// set the page size equal to
+#define DefaultPageSize	SectorSize	// set the page size equal to
 					// the disk sector size, for
 					// simplicity
+#define DefaultNumPhysPages 32
+#define DefaultTLBSize	4		// if there is a TLB, make it small
+
+extern int PageSize;		// bytes in a page; a power of 2
+extern int PageShift;		// log2(PageSize)
+extern int NumPhysPages;	// page frames in physical memory
+extern int TLBSize;		// entries in the TLB, if there is one
 
-#define NumPhysPages    32
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+#define InstrsPerPage	(PageSize / 4)	// instruction words in one page
+
+extern void SetMemoryGeometry(int numPages, int pageSize, int tlbSize);
+				// Choose the sizes above; called before
+				// the Machine is created
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -86,11 +100,115 @@ class Instruction {
 
     char opCode;     // Type of instruction.  This is NOT the same as the
     		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction.
+    unsigned char rs, rt, rd; // Three registers from instruction.
     int extra;       // Immediate or target or shamt field or offset.
                      // Immediates are sign-extended.
 };
 
+// The basic block engine (blocksim.cc) runs user code as "threaded code":
+// each instruction is translated once into a call to a handler routine
+// specialized for its opcode, and straight-line runs of instructions
+// (basic blocks) are executed back to back, without going through
+// the full fetch/decode/dispatch cycle of OneInstruction.
+//
+// A handler returns FALSE if the instruction trapped to the kernel.
+
+class Machine;
+class CompiledBlock;
+typedef bool (*OpHandler)(Machine *machine, Instruction *instr);
+
+class ThreadedOp {
+  public:
+    OpHandler handler;	// routine to execute this instruction
+    int blockLength;	// number of ops in the basic block starting here,
+			// or 0 if we haven't needed to find out yet
+    int hits;		// times the block starting here has been run
+    CompiledBlock *compiled;	// compiled form of that block, if it
+			// has been run often enough to be worth it
+    Instruction instr;	// the decoded instruction
+};
+
+// Blocks that are run often ("hot" blocks) are compiled a second time
+// (blockcomp.cc) into a shorter list of micro-operations.  Compiled code
+// does not update the PC registers or the clock after every instruction,
+// only before an instruction that might trap to the kernel, and most
+// delayed loads are done immediately, when nothing can tell the difference.
+//
+// A micro-op handler returns FALSE if execution should leave the block.
+
+class MicroOp;
+typedef bool (*MicroHandler)(Machine *machine, MicroOp *op);
+
+#define MicroPrecise	0x1	// set PCs and clock before running this op
+#define MicroStore	0x2	// op may modify memory, including code
+#define MicroSlow	0x4	// op is run by its basic block engine handler,
+				// which also advances the PCs
+
+class MicroOp {
+  public:
+    MicroHandler handler;	// routine to execute this op
+    char flags;			// MicroPrecise, etc.
+    unsigned char rd, rs, rt;	// register operands
+    int extra;			// immediate operand
+    int offset;			// byte offset of the instruction in its block
+    ThreadedOp *threaded;	// for MicroSlow ops, the original instruction
+};
+
+class CompiledBlock {
+  public:
+    MicroOp *ops;		// micro-ops to run, in order
+    int numOps;			// how many there are
+};
+
+#define HotBlockThreshold 32	// compile a block after this many runs
+#define MaxCodeFlushes	4	// stop compiling code on a physical page 
+				// after it has been overwritten this often
+
+// A "soft TLB" caches recent successful translations, so that most
+// memory references skip Machine::Translate altogether.  It is
+// direct-mapped on the virtual page number, and there is one for reads
+// and one for writes, so that a page is only entered in the write table
+// once Translate has checked that it is writable and marked it dirty.
+//
+// The soft TLB is not visible to the kernel, except that it must be
+// flushed (Machine::FlushSoftTLB) whenever the kernel changes the
+// translation behind the machine's back -- "pageTable",
+// "pageTableSize", the TLB, or an entry's valid, readOnly, use or
+// dirty bits.  Switching address spaces and traps to the kernel flush
+// it automatically.
+
+#define SoftTLBSize	64	// entries in each soft TLB; a power of 2
+
+class SoftTLBEntry {
+  public:
+    int virtualPage;		// the page this entry maps, or -1 if none
+    int physicalPage;		// the page frame it maps to
+    char *memory;		// where that frame is in mainMemory
+};
+
+// The state private to each simulated CPU.  Main memory, and the caches
+// of decoded code, are shared by all of them.  The Machine has a single
+// "current" CPU at a time: its registers, TLB and page table are the ones
+// seen through Machine::registers, tlb, etc. (see Machine::SwitchCPU).
+
+class CPUState {
+  public:
+    int registers[NumTotalRegs];	// this CPU's register file
+    TranslationEntry *tlb;		// its TLB, if there is one ...
+    TranslationEntry *pageTable;	// ... or its page table
+    unsigned int pageTableSize;
+    SoftTLBEntry *softRead;		// its soft TLBs
+    SoftTLBEntry *softWrite;
+    int runUntilTime;			// see Machine::Debugger
+};
+
+// How to run user programs.
+
+enum EngineType { InterpretEngine,	// one instruction at a time
+		  BlockEngine,		// a basic block at a time
+		  CompileEngine		// the same, but compile hot blocks
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -101,12 +219,13 @@ class Instruction {
 // If we were to implement more of the UNIX system calls, we ought to be
 // able to run Nachos on top of Nachos!
 //
-// The procedures in this class are defined in machine.cc, mipssim.cc, and
-// translate.cc.
+// The procedures in this class are defined in machine.cc, mipssim.cc,
+// blocksim.cc, blockcomp.cc, parallel.cc, and translate.cc.
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, EngineType engineType, int numCPUs);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -114,17 +233,75 @@ class Machine {
     void Run();	 		// Run a user program
 
     int ReadRegister(int num);	// read the contents of a CPU register
+    int ReadRegister(int cpu, int num);
+				// the same, but from the registers of
+				// "cpu", current or not
 
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    int NumCPUs() { return numCPUs; }
+    int CurrentCPU() { return currentCPU; }
+				// How many CPUs there are, and which one
+				// we are currently simulating
+    void SwitchCPU(int cpu);	// Make "cpu" the current CPU; only the
+				// kernel's CPU interleaving should call this
+    void UseHostThreads(int count);
+				// Run up to "count" CPUs at once, on 
+				// separate host threads (see parallel.cc)
+    bool RunAhead(bool *eligible, int maxInstrs, int *done);
+				// Run the user code of some CPUs in 
+				// parallel, until they trap or have run
+				// "maxInstrs" instructions
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    bool ExecuteInstruction(Instruction *instr);
+				// Execute an already decoded instruction;
+				// FALSE if it raised an exception
+    void RunBlocks();		// Run a user program a basic block at a 
+				// time (see blocksim.cc)
+    int RunUserCode(int maxInstrs);
+				// Run a CPU ahead on a host thread, without
+				// trapping to the kernel; returns the
+				// number of instructions run
+    ThreadedOp *FetchBlock(int physAddr, int *length);
+				// Return the threaded code for the basic 
+				// block starting at "physAddr"
+    CompiledBlock *CompileBlock(ThreadedOp *head, int length);
+				// Compile a hot basic block (see blockcomp.cc)
+    void RunCompiled(CompiledBlock *block);
+				// Run a compiled block from the start
+    bool FreeCompiledCode(int physPage);
+				// Throw away the compiled blocks of a page;
+				// TRUE if there were any
+    bool FreeCompiledBlock(ThreadedOp *head);
+				// The same, for the block starting at "head"
+    void RethreadWord(int physAddr);
+				// Translate a changed instruction word
+				// again, and forget the blocks it is in
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
+
+    Instruction *FetchDecoded(int physAddr);
+				// Return the decoded form of the instruction
+				// word at "physAddr", decoding its page
+				// on first use
+    void WordWritten(int physAddr);
+				// A store has written the word at 
+				// "physAddr"; decode it again, if need be
+    void InvalidateDecodedPage(int physPage);
+    void InvalidateDecodeCache();
+				// Forget the decoded instructions of one
+				// physical page, or of all of them.  Must be
+				// called whenever "mainMemory" is modified
+				// other than through WriteMem.
+    void ResetFrame(int physPage);
+				// The same, for a page frame given to a
+				// new program; it may be compiled again
     
     bool ReadMem(int addr, int size, int* value);
     bool WriteMem(int addr, int size, int value);
@@ -138,6 +315,12 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    ExceptionType QuickTranslate(int virtAddr, int* physAddr, int size,
+				bool writing);
+				// Same as Translate, but try the soft TLB
+				// first
+    void FlushSoftTLB();	// Forget all soft TLB entries; must be 
+				// called whenever the translation changes
 
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
@@ -155,7 +338,8 @@ class Machine {
 
     char *mainMemory;		// physical memory to store user program,
 				// code and data, while executing
-    int registers[NumTotalRegs]; // CPU registers, for executing user programs
+    int *registers;		// CPU registers, for executing user programs
+				// (those of the current CPU)
 
 
 // NOTE: the hardware translation of virtual addresses in the user program
@@ -175,6 +359,9 @@ class Machine {
 // space, stored in memory), there is only one TLB (implemented in hardware).
 // Thus the TLB pointer should be considered as *read-only*, although 
 // the contents of the TLB are free to be modified by the kernel software.
+//
+// With more than one CPU, each has its own TLB and page table pointer;
+// these fields are those of the current CPU.
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
@@ -183,6 +370,45 @@ class Machine {
     unsigned int pageTableSize;
 
   private:
+    Machine(Machine *whole, int cpu);
+				// A view of one CPU of "whole", for 
+				// running it on a host thread
+    void SaveCPUState();	// Copy the current CPU's fields back 
+				// into its CPUState
+    void LoadCPUState(CPUState *state);
+				// And the other way around
+
+    SoftTLBEntry *LookupSoftTLB(SoftTLBEntry *table, int virtAddr, int size);
+    void FillSoftTLB(SoftTLBEntry *table, int virtAddr, int physAddr);
+				// Find or enter a translation in the soft TLB
+    SoftTLBEntry *softRead;	// soft TLB for reads (and fetches) ...
+    SoftTLBEntry *softWrite;	// ... and for writes
+
+    CPUState *cpus;		// the state of each CPU; the current one's
+				// is loaded into the fields above
+    int numCPUs;		// how many CPUs there are
+    int currentCPU;		// the one we are simulating right now
+    Machine *parent;		// if this is a view of one CPU, the
+				// machine it belongs to; else NULL
+    Machine **views;		// a view of each CPU, to run it ahead
+    int *frameOwner;		// which CPU may use each page frame, 
+				// while running ahead
+    int hostThreads;		// how many host threads to run ahead on,
+				// or 0 if we don't
+
+    Instruction **decodedPages;	// decoded copy of each physical page,
+				// allocated the first time it is fetched from
+    bool *pageDecoded;		// is decodedPages[i] in sync with memory?
+    ThreadedOp **threadedPages;	// threaded code for each physical page,
+				// used by the basic block engine
+    bool *pageThreaded;		// is threadedPages[i] in sync with memory?
+    int *codeFlushes;		// times each page's compiled code was thrown
+				// away because the page was overwritten
+    bool codeChanged;		// set when a store changes an instruction
+				// in a block that has been run, so that
+				// the block being run stops
+    EngineType engine;		// how to run user code
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -19,6 +19,8 @@ static void NetworkReadPoll(int arg)
 { Network *net = (Network *)arg; net->CheckPktAvail(); }
 static void NetworkSendDone(int arg)
 { Network *net = (Network *)arg; net->SendDone(); }
+static void NetworkPacketReady(int arg)
+{ Network *net = (Network *)arg; net->PacketReady(); }
 
 // Initialize the network emulation
 //   addr is used to generate the socket name
@@ -44,29 +46,45 @@ Network::Network(NetworkAddress addr, double reliability,
     AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
 						 // in the current directory.
 
-    // start polling for incoming packets
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+    // start waiting for incoming packets
+    WaitForPacket();
 }
 
 Network::~Network()
 {
+    IgnoreFile(sock);
     CloseSocket(sock);
     DeAssignNameToSocket(sockName);
 }
 
-// if a packet is already buffered, we simply delay reading 
-// the incoming packet.  In real life, the incoming 
-// packet might be dropped if we can't read it in time.
+// ask the host to tell us when the next packet arrives on the socket,
+// rather than checking for one every so often
 void
-Network::CheckPktAvail()
+Network::WaitForPacket()
+{
+    interrupt->WatchInput(sock, NetworkPacketReady, (int)this);
+}
+
+// the host has a packet for us; it takes NetworkTime to receive it
+void
+Network::PacketReady()
 {
-    // schedule the next time to poll for a packet
     interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+}
 
+// if a packet is already buffered, we simply delay reading 
+// the incoming packet (until Receive takes the buffered one).  
+// In real life, the incoming packet might be dropped if we 
+// can't read it in time.
+void
+Network::CheckPktAvail()
+{
     if (inHdr.length != 0) 	// do nothing if packet is already buffered
 	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
+    if (!PollSocket(sock)) { 	// or if there's no packet to be read after all
+	WaitForPacket();
 	return;
+    }
 
     // otherwise, read packet in
     char *buffer = new char[MaxWireSize];
@@ -133,7 +151,9 @@ Network::Receive(char* data)
     PacketHeader hdr = inHdr;
 
     inHdr.length = 0;
-    if (hdr.length != 0)
+    if (hdr.length != 0) {
     	bcopy(inbox, data, hdr.length);
+	WaitForPacket();	// the buffer is free for the next one
+    }
     return hdr;
 }
@@ -79,6 +79,7 @@ class Network {
     void SendDone();		// Interrupt handler, called when message is 
 				// sent
     void CheckPktAvail();	// Check if there is an incoming packet
+    void PacketReady();		// The host has a packet for us
 
   private:
     NetworkAddress ident;	// This machine's network address
@@ -96,6 +97,9 @@ class Network {
 				//   network
     PacketHeader inHdr;		// Information about arrived packet
     char inbox[MaxPacketSize];  // Data for arrived packet
+
+    void WaitForPacket();	// Ask the host to tell us when a packet
+				// arrives
 };
 
 #endif // NETWORK_H
@@ -0,0 +1,251 @@
+// parallel.cc
+//	Routines to run the user code of several simulated CPUs at once,
+//	each on its own host thread.
+//
+//	The Nachos kernel is not safe to run on more than one host thread,
+//	and its threads switch stacks with SWITCH, so the CPUs normally
+//	take turns on a single host thread (see Interrupt::NextSlice).  But
+//	between traps, a CPU running user code only touches its own
+//	registers, TLB, and the page frames it maps.  So at the start of
+//	each round of turns, CPUs that are sitting in user code, and that
+//	don't share any page frames with one another, are "run ahead" in
+//	parallel: each runs on a host thread until it has used up its turn,
+//	or would need the kernel -- a system call, a page fault, anything
+//	that traps.  The trapping instruction is left undone, for the CPU
+//	to execute again (this time for real) when its turn comes.
+//
+//	This is a conservative parallel simulation: the host threads only
+//	meet at the start of each round, and nothing they do can affect
+//	one another, so the result depends only on the length of the turns.
+//	Running ahead also stops before the next pending interrupt is due,
+//	so that it fires at the same tick as it would otherwise.  (What
+//	does change is when the CPUs see things the kernel does for them
+//	during the round, such as an IPI: they see them after they have
+//	run ahead.)
+//
+//	Running ahead uses the threaded code of the basic block engine
+//	(see blocksim.cc), without compiling anything.  It is turned off
+//	while single stepping, or tracing instructions or translations.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "machine.h"
+#include "system.h"
+
+// The work handed out to the host threads, one CPU at a time.  Set up
+// by Machine::RunAhead before it starts the host threads.
+
+static Machine *aheadViews[MaxCPUs];	// the CPUs to run ahead
+static int aheadDone[MaxCPUs];		// and how many instructions each ran
+static double aheadTime[MaxCPUs];	// and for how long, on the host
+static int aheadCount;			// how many CPUs there are to run
+static int aheadLimit;			// how far to run them
+static int aheadThreads;		// how many host threads there are
+
+//----------------------------------------------------------------------
+// RunAheadThread
+// 	The work of one host thread: run ahead every aheadThreads'th CPU,
+//	starting with CPU "which".
+//
+//	"which" -- the number of the host thread
+//----------------------------------------------------------------------
+
+static void
+RunAheadThread(int which)
+{
+    double start;
+
+    for (int i = which; i < aheadCount; i += aheadThreads) {
+	start = HostTime();
+	aheadDone[i] = aheadViews[i]->RunUserCode(aheadLimit);
+	aheadTime[i] = HostTime() - start;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::Machine
+// 	Initialize a view of one CPU of a machine, for running it on a
+//	host thread.  It shares main memory and the code caches with the
+//	machine; its registers, TLB, and so on are those of the CPU, as
+//	loaded by LoadCPUState.
+//
+//	"whole" -- the machine to look at
+//	"cpu" -- the CPU to look at
+//----------------------------------------------------------------------
+
+Machine::Machine(Machine *whole, int cpu)
+{
+    parent = whole;
+    mainMemory = whole->mainMemory;
+    cpus = whole->cpus;
+    numCPUs = whole->numCPUs;
+    currentCPU = cpu;
+    LoadCPUState(&cpus[cpu]);
+    decodedPages = whole->decodedPages;
+    pageDecoded = whole->pageDecoded;
+    threadedPages = whole->threadedPages;
+    pageThreaded = whole->pageThreaded;
+    codeFlushes = whole->codeFlushes;
+    codeChanged = FALSE;
+    engine = BlockEngine;
+    singleStep = FALSE;
+    views = NULL;
+    frameOwner = NULL;
+    hostThreads = 0;
+}
+
+//----------------------------------------------------------------------
+// Machine::UseHostThreads
+// 	Start running CPUs ahead on host threads.  Called by the kernel
+//	at startup, if asked to.
+//
+//	"count" -- the most host threads to use at once
+//----------------------------------------------------------------------
+
+void
+Machine::UseHostThreads(int count)
+{
+    ASSERT(count > 0 && hostThreads == 0 && parent == NULL);
+    hostThreads = min(count, numCPUs);
+    views = new Machine *[numCPUs];
+    for (int cpu = 0; cpu < numCPUs; cpu++)
+	views[cpu] = new Machine(this, cpu);
+    frameOwner = new int[NumPhysPages];
+    aheadThreads = hostThreads;
+    StartHostThreads(hostThreads, RunAheadThread);
+}
+
+//----------------------------------------------------------------------
+// Machine::RunAhead
+// 	Run the user code of the "eligible" CPUs in parallel, on host
+//	threads.  Called by the interrupt simulation at the start of a
+//	round of turns, when every CPU is at an instruction boundary.
+//
+//	A CPU is only run ahead if none of the page frames it can reach
+//	(through its page table, or its TLB) can be reached by another
+//	eligible CPU, and it is left alone otherwise.  We don't bother
+//	unless at least two CPUs can be run ahead.
+//
+// Returns:
+//	FALSE if no CPU was run ahead
+//
+//	"eligible" -- which CPUs are sitting in user code
+//	"maxInstrs" -- the most instructions any CPU may execute
+//	"done" -- set to the number of instructions each CPU executed
+//----------------------------------------------------------------------
+
+bool
+Machine::RunAhead(bool *eligible, int maxInstrs, int *done)
+{
+    TranslationEntry *entries;
+    int numEntries, cpu, i, page;
+    bool shares;
+    double start;
+
+    if (hostThreads == 0 || maxInstrs <= 0 || singleStep
+		|| DebugIsEnabled('m') || DebugIsEnabled('a'))
+	return FALSE;
+    SaveCPUState();			// views look at the CPUState
+
+    // find out who uses which page frame: a CPU, or -2 if more than one
+    for (i = 0; i < NumPhysPages; i++)
+	frameOwner[i] = -1;
+    for (cpu = 0; cpu < numCPUs; cpu++) {
+	if (!eligible[cpu])
+	    continue;
+	views[cpu]->LoadCPUState(&cpus[cpu]);
+	entries = views[cpu]->tlb != NULL ? views[cpu]->tlb
+					: views[cpu]->pageTable;
+	numEntries = views[cpu]->tlb != NULL ? TLBSize
+					: views[cpu]->pageTableSize;
+	for (i = 0; i < numEntries; i++) {
+	    page = entries[i].physicalPage;
+	    if (!entries[i].valid || page < 0 || page >= NumPhysPages)
+		continue;
+	    if (frameOwner[page] == -1)
+		frameOwner[page] = cpu;
+	    else if (frameOwner[page] != cpu)
+		frameOwner[page] = -2;
+	}
+    }
+
+    aheadCount = 0;
+    for (cpu = 0; cpu < numCPUs; cpu++) {
+	done[cpu] = 0;
+	if (!eligible[cpu])
+	    continue;
+	entries = views[cpu]->tlb != NULL ? views[cpu]->tlb
+					: views[cpu]->pageTable;
+	numEntries = views[cpu]->tlb != NULL ? TLBSize
+					: views[cpu]->pageTableSize;
+	shares = FALSE;
+	for (i = 0; i < numEntries && !shares; i++) {
+	    page = entries[i].physicalPage;
+	    if (entries[i].valid && page >= 0 && page < NumPhysPages)
+		shares = (frameOwner[page] != cpu);
+	}
+	if (!shares)
+	    aheadViews[aheadCount++] = views[cpu];
+    }
+    if (aheadCount < 2)
+	return FALSE;
+
+    DEBUG('i', "Running %d CPUs ahead, %d instructions\n", aheadCount,
+					maxInstrs);
+    aheadLimit = maxInstrs;
+    start = HostTime();
+    RunHostThreads();
+    stats->hostParallelTime += HostTime() - start;
+    for (i = 0; i < aheadCount; i++) {
+	done[aheadViews[i]->currentCPU] = aheadDone[i];
+	stats->aheadTicks += aheadDone[i] * UserTick;
+	stats->hostSerialTime += aheadTime[i];
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunUserCode
+// 	Run a view of one CPU ahead, on a host thread, a basic block at
+//	a time.  Stop after "maxInstrs" instructions, or just before
+//	an instruction that would trap to the kernel.  Since a view's
+//	RaiseException does nothing, such an instruction has no effect.
+//
+// Returns:
+//	the number of instructions executed
+//
+//	"maxInstrs" -- the most instructions to execute
+//----------------------------------------------------------------------
+
+int
+Machine::RunUserCode(int maxInstrs)
+{
+    int physAddr, length, i;
+    int executed = 0;
+    ThreadedOp *op;
+
+    ASSERT(parent != NULL);
+    while (executed < maxInstrs) {
+	if (QuickTranslate(registers[PCReg], &physAddr, 4, FALSE)
+							!= NoException)
+	    break;
+	op = FetchBlock(physAddr, &length);
+	if (registers[NextPCReg] != registers[PCReg] + 4)
+	    length = 1;			// in a branch delay slot
+	length = min(length, maxInstrs - executed);
+	codeChanged = FALSE;
+	for (i = 0; i < length; i++, op++) {
+	    if (!(*op->handler)(this, &op->instr))
+		return executed;	// trapped
+	    executed++;
+	    if (codeChanged)
+		break;			// it may have changed its own code
+	}
+    }
+    return executed;
+}
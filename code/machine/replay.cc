@@ -0,0 +1,270 @@
+// replay.cc
+//	Routines to record the schedule of a run, and replay it.  See
+//	replay.h.
+//
+//	The log starts with ReplayMagic, and whether the timer went off
+//	at random; then come the events, each as two numbers:
+//
+//		(ticks since the last event) * 4 + kind of event
+//		value
+//
+//	Each number is written 7 bits to a byte, low bits first, with the
+//	top bit set on every byte but the last.  Most events take 2 or 3
+//	bytes.
+//
+//	With several CPUs, the clock is wound back at the start of each
+//	CPU's turn (see Interrupt::NextSlice), so the ticks since the last
+//	event may be negative: they are written as twice as many, or for
+//	-n, as 2n - 1.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "replay.h"
+#include "system.h"
+
+// for debugging, and for reporting where a replay diverged
+static char *eventNames[] = { "timer delay", "interrupt", "switch to thread" };
+
+//----------------------------------------------------------------------
+// ReplayLog::ReplayLog
+// 	Open a log, to record this run in, or to replay.
+//
+//	"fileName" is the file the log is in.
+//	"replay" is TRUE to replay the log, FALSE to record it.
+//	"doRandom" is whether the timer goes off at random, when
+//		recording; when replaying, the log says.
+//----------------------------------------------------------------------
+
+ReplayLog::ReplayLog(char *fileName, bool replay, bool doRandom)
+{
+    unsigned int magic, flags;
+
+    name = fileName;
+    replaying = replay;
+    buffer = new char[ReplayBufferSize];
+    position = limit = 0;
+    done = FALSE;
+    lastTicks = 0;
+    numEvents = numBytes = 0;
+    if (replaying) {
+	file = OpenForReadWrite(name, TRUE);
+	if (!GetNumber(&magic) || magic != ReplayMagic || !GetNumber(&flags)) {
+	    fprintf(stderr, "%s is not a replay log.\n", name);
+	    fflush(stderr);
+	    Abort();
+	}
+	randomTimer = (flags != 0);
+    } else {
+	file = OpenForWrite(name);
+	randomTimer = doRandom;
+	PutNumber(ReplayMagic);
+	PutNumber(randomTimer ? 1 : 0);
+    }
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::~ReplayLog
+// 	Write out the rest of the log being recorded, and close it.
+//----------------------------------------------------------------------
+
+ReplayLog::~ReplayLog()
+{
+    Flush();
+    Close(file);
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::Delay
+// 	Called each time the timer picks a random delay before going off
+//	again.
+//
+//	"delay" is the one it picked.
+//
+// Returns:
+//	The delay to use: "delay", or, when replaying, the one logged.
+//----------------------------------------------------------------------
+
+int
+ReplayLog::Delay(int delay)
+{
+    return Event(TimerDelay, delay);
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::Interrupted
+// 	Called each time an interrupt handler is about to be called.
+//
+//	"type" is the IntType of the interrupt.
+//----------------------------------------------------------------------
+
+void
+ReplayLog::Interrupted(int type)
+{
+    (void) Event(InterruptDelivered, type);
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::Switched
+// 	Called each time the scheduler gives the CPU to another thread.
+//
+//	"threadId" is the ID of the thread that gets it.
+//----------------------------------------------------------------------
+
+void
+ReplayLog::Switched(int threadId)
+{
+    (void) Event(ThreadSwitch, threadId);
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::Print
+// 	Print how many events were logged, or replayed, and in how many
+//	bytes.
+//----------------------------------------------------------------------
+
+void
+ReplayLog::Print()
+{
+    printf("Replay log \"%s\": %d events %s, in %d bytes\n", name, numEvents,
+	   replaying ? "replayed" : "recorded", numBytes);
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::Event
+// 	Log an event, happening now.  Or when replaying, check that it
+//	is the next event logged, at the same time (and for anything but
+//	a timer delay, with the same value); if not, say where the run
+//	diverged, and abort.
+//
+//	"event" is the kind of event.
+//	"value" is its value.
+//
+// Returns:
+//	The value logged: "value", unless it is replaying a timer delay.
+//----------------------------------------------------------------------
+
+int
+ReplayLog::Event(ReplayEvent event, int value)
+{
+    int ticks = stats->totalTicks;
+    int delta = ticks - lastTicks;
+    unsigned int code, logged;
+    int loggedTicks;
+    ReplayEvent loggedEvent;
+
+    DEBUG('i', "Replay log: %s %d at time %d\n", eventNames[event], value,
+	  ticks);
+    ASSERT(value >= 0);
+    if (!replaying) {
+	if (position > ReplayBufferSize - ReplayEventSize)
+	    Flush();			// only ever between events
+	code = (delta >= 0) ? delta * 2 : -delta * 2 - 1;
+	PutNumber(code * 4 + event);
+	PutNumber(value);
+	lastTicks = ticks;
+	numEvents++;
+	return value;
+    }
+
+    if (done)
+	return value;
+    if (!GetNumber(&code) || !GetNumber(&logged)) { // at the end, or
+	done = TRUE;				 // at an event cut off
+	printf("Replay of \"%s\" done, after %d events, at time %d.\n",
+	       name, numEvents, ticks);
+	return value;
+    }
+    loggedEvent = (ReplayEvent) (code & 3);
+    code >>= 2;
+    loggedTicks = lastTicks + ((code & 1) ? -(int) (code >> 1) - 1 
+						: (int) (code >> 1));
+    if (loggedEvent != event || loggedTicks != ticks
+		|| (event != TimerDelay && (int) logged != value)) {
+	fprintf(stderr, "Replay of \"%s\" diverged, at event %d:\n", name,
+		numEvents);
+	fprintf(stderr, "\tlogged: %s %d at time %d\n", 
+		eventNames[loggedEvent], logged, loggedTicks);
+	fprintf(stderr, "\tnow: %s %d at time %d\n", eventNames[event],
+		value, ticks);
+	fflush(stderr);
+	Abort();
+    }
+    lastTicks = ticks;
+    numEvents++;
+    return logged;
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::PutNumber
+// 	Add a number to the log being recorded, 7 bits to a byte.  The
+//	caller has made sure it fits in the buffer.
+//
+//	"n" is the number.
+//----------------------------------------------------------------------
+
+void
+ReplayLog::PutNumber(unsigned int n)
+{
+    do {
+	ASSERT(position < ReplayBufferSize);
+	buffer[position++] = (n & 0x7f) | ((n > 0x7f) ? 0x80 : 0);
+	numBytes++;
+	n >>= 7;
+    } while (n != 0);
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::GetNumber
+// 	Read the next number from the log being replayed, reading more
+//	of the log when the buffer is used up.
+//
+//	"n" is where to put the number.
+//
+// Returns:
+//	FALSE if the log is at its end, or ends partway through the
+//	number.
+//----------------------------------------------------------------------
+
+bool
+ReplayLog::GetNumber(unsigned int *n)
+{
+    int shift = 0;
+    char c;
+
+    *n = 0;
+    do {
+	if (position == limit) {
+	    limit = ReadPartial(file, buffer, ReplayBufferSize);
+	    position = 0;
+	    if (limit <= 0) {		// the end, or what was written
+		limit = 0;		// out before a crash
+		return FALSE;
+	    }
+	}
+	c = buffer[position++];
+	numBytes++;
+	*n |= (c & 0x7f) << shift;
+	shift += 7;
+    } while (c & 0x80);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ReplayLog::Flush
+// 	Write out what has been recorded in the buffer.  Called between
+//	events, so the log never ends partway through one -- unless
+//	Nachos is killed while it is being written.
+//----------------------------------------------------------------------
+
+void
+ReplayLog::Flush()
+{
+    if (replaying || position == 0)
+	return;
+    WriteFile(file, buffer, position);
+    position = 0;
+}
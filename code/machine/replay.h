@@ -0,0 +1,96 @@
+// replay.h
+//	Data structures to record the schedule of a Nachos run, and to
+//	replay it.
+//
+//	Nachos is deterministic, given its inputs; the one that makes
+//	runs hard to reproduce is the random timer (-rs), whose delays
+//	come from Random() -- and so change if anything else draws a
+//	random number.  With "-record file", we log each random timer
+//	delay, and, so that a later run can be checked against this one,
+//	each interrupt delivered (Interrupt::CheckIfDue) and each context
+//	switch (Scheduler::Run), with the time it happened.
+//
+//	With "-replay file", the timer goes off after the logged delays,
+//	instead of random ones, and each interrupt and switch is checked
+//	against the log.  If the run diverges -- say a change to the kernel
+//	made some thread run earlier -- we report the first event that is
+//	different, and where, and abort.  Checking is cheap, so a long run
+//	can be replayed against each version of the kernel, to bisect.
+//	Once the log runs out, the run goes on unchecked.
+//
+//	If a recorded run aborts, the log is written out first (see
+//	CallOnAbort), so the crash can be replayed.  The log is only ever
+//	written out between events; if it still ends partway through one
+//	(say Nachos was killed), that event is taken as the end.
+//
+//	Console and network input are not logged; a run that reads them
+//	only replays if they come in the same way.
+//
+//	The log is compact: each event is its kind and the ticks since
+//	the last one, in one number, then its value (a delay, the type of
+//	an interrupt, or the ID of the thread switched to), each in as
+//	few bytes as it needs, 7 bits per byte.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The kinds of event in the log.
+enum ReplayEvent { TimerDelay, InterruptDelivered, ThreadSwitch };
+
+#define ReplayBufferSize 65536	// how much of the log we read or write
+				// at a time
+#define ReplayEventSize	10	// the most bytes one event can take
+#define ReplayMagic 0x4e52504c	// at the start of each log: "NRPL"
+
+// The following class defines a log of a run, being recorded or
+// replayed.
+
+class ReplayLog {
+  public:
+    ReplayLog(char *fileName, bool replay, bool doRandom);
+				// Start recording a log (of a run with a
+				// random timer or not), or replaying one
+    ~ReplayLog();		// Finish writing it out, or reading it
+
+    bool IsReplaying() { return replaying; }
+    bool RandomTimer() { return randomTimer; }
+				// whether the timer went off at random,
+				// in the run logged
+
+    int Delay(int delay);	// Log a random timer delay; or when
+				// replaying, return the logged one instead
+    void Interrupted(int type);	// Log an interrupt, or check it
+    void Switched(int threadId); // Log a switch to a thread, or check it
+
+    void Print();		// Print how many events were logged
+    void Flush();		// Write out what has been logged so far,
+				// if recording
+
+  private:
+    char *name;			// the file the log is in,
+    int file;			// and its file descriptor
+    bool replaying;		// TRUE if reading the log, not writing
+    bool randomTimer;		// whether the timer goes off at random
+    char *buffer;		// the part of the log being read or written
+    int position;		// where in the buffer the next byte is
+    int limit;			// how many bytes in the buffer were read
+    bool done;			// TRUE once the replay is at the end
+    int lastTicks;		// when the last event happened
+    int numEvents;		// how many events so far
+    int numBytes;		// and how many bytes they took
+
+    int Event(ReplayEvent event, int value);
+				// Log an event, or check it is the next
+				// one logged; returns the logged value
+    void PutNumber(unsigned int n);	// Write a number, 7 bits a byte
+    bool GetNumber(unsigned int *n);	// Read one; FALSE at the end
+};
+
+#endif // REPLAY_H
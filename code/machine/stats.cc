@@ -11,6 +11,57 @@
 #include "utility.h"
 #include "stats.h"
 
+//----------------------------------------------------------------------
+// Histogram::Histogram
+// 	Initialize a histogram with nothing in it.
+//----------------------------------------------------------------------
+
+Histogram::Histogram()
+{
+    for (int i = 0; i < HistogramBuckets; i++)
+	buckets[i] = 0;
+    count = 0;
+}
+
+//----------------------------------------------------------------------
+// Histogram::Add
+// 	Count a time in the bucket it falls in: the number of bits
+//	needed to write it down.
+//
+//	"ticks" is the time; if negative, it counts as 0.
+//----------------------------------------------------------------------
+
+void
+Histogram::Add(int ticks)
+{
+    int i = 0;
+
+    for (; ticks > 0; ticks >>= 1)
+	i++;
+    buckets[i]++;
+    count++;
+}
+
+//----------------------------------------------------------------------
+// Histogram::Print
+// 	Print how many times fell in each bucket, skipping the empty ones,
+//	as "low-high:count".
+//----------------------------------------------------------------------
+
+void
+Histogram::Print()
+{
+    for (int i = 0; i < HistogramBuckets; i++) {
+	if (buckets[i] == 0)
+	    continue;
+	if (i <= 1)
+	    printf(" %d:%d", i, buckets[i]);
+	else
+	    printf(" %u-%u:%d", 1u << (i - 1), (1u << i) - 1, buckets[i]);
+    }
+    printf("\n");
+}
+
 //----------------------------------------------------------------------
 // Statistics::Statistics
 // 	Initialize performance metrics to zero, at system startup.
@@ -22,6 +73,11 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numContextSwitches = switchTicks = numRegisterCopies = 0;
+    numSwitchesTimed = 0;
+    switchHostTime = 0;
+    aheadTicks = 0;
+    hostSerialTime = hostParallelTime = 0;
 }
 
 //----------------------------------------------------------------------
@@ -41,4 +97,19 @@ Statistics::Print()
     printf("Paging: faults %d\n", numPageFaults);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    printf("Threads: context switches %d", numContextSwitches);
+    if (numContextSwitches > 0)
+	printf(", %.1f ticks each", (double) switchTicks / numContextSwitches);
+    if (numSwitchesTimed > 0)
+	printf(", %.0f ns each", switchHostTime * 1e9 / numSwitchesTimed);
+    if (numRegisterCopies > 0)
+	printf(", user registers copied %d times", numRegisterCopies);
+    printf("\n");
+    if (readyLatency.Count() > 0) {
+	printf("Ready list latency, in ticks:");
+	readyLatency.Print();
+    }
+    if (aheadTicks > 0)		// the speedup over running it all serially
+	printf("Host threads: user ticks run ahead %d, speedup %.2f\n",
+	    aheadTicks, hostSerialTime / hostParallelTime);
 }
@@ -13,6 +13,27 @@
 
 #include "copyright.h"
 
+// The following class defines a histogram of some time (in ticks), in
+// buckets a power of 2 wide: bucket 0 counts times of 0, bucket 1
+// times of 1, bucket 2 times of 2 or 3, bucket 3 times of 4 to 7, and
+// so on.  So it is small, whatever the range of times.
+
+#define HistogramBuckets 32		// enough for any positive int
+
+class Histogram {
+  public:
+    Histogram();			// initialize an empty histogram
+
+    void Add(int ticks);		// count one more time
+    int Count() { return count; }	// how many times there are
+    void Print();			// print the non-empty buckets,
+					// on one line
+
+  private:
+    int buckets[HistogramBuckets];
+    int count;
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -35,6 +56,20 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numContextSwitches;	// number of times a thread started running
+    int switchTicks;		// time they took, in ticks (the clock only
+				// advances with interrupts on, so this is
+				// usually 0)
+    int numSwitchesTimed;	// number of them timed on the host clock,
+    double switchHostTime;	// and the host seconds those took
+    int numRegisterCopies;	// number of times a thread's user registers
+				// were saved or restored
+    Histogram readyLatency;	// how long threads waited on the ready
+				// list, each time before they ran
+
+    int aheadTicks;		// user time run ahead on host threads
+    double hostSerialTime;	// host seconds those host threads were busy
+    double hostParallelTime;	// host seconds it took them, all together
 
     Statistics(); 		// initialize everything to zero
 
@@ -55,6 +90,9 @@ class Statistics {
 #define SeekTime 	500    	// time disk takes to seek past one track
 #define ConsoleTime 	100	// time to read or write one character
 #define NetworkTime 	100   	// time to send or receive one packet
-#define TimerTicks 	100    	// (average) time between timer interrupts
+#define TimerTicks 	100    	// the usual time slice (and, with -rs, the
+				// average time between timer interrupts)
+#define PollTime 	1000	// time between checks for input from the
+				// host, while there is other work to do
 
 #endif // STATS_H
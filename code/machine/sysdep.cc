@@ -29,6 +29,8 @@ extern "C" {
 #include <stdio.h>
 #include <string.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/socket.h>
@@ -45,6 +47,13 @@ extern "C" {
 #include <fcntl.h>
 #include <sys/time.h>
 #endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <errno.h>
+#else
+#include <poll.h>
+#include <errno.h>
+#endif
 
 
 // UNIX routines called by procedures in this file 
@@ -143,6 +152,197 @@ PollFile(int fd)
     return TRUE;
 }
 
+// The files being watched for input (see WatchFile).  There are only
+// ever a few -- the console, the network -- so we just keep a table.
+
+#define MaxWatchedFiles	16
+
+struct WatchedFile {
+    int fd;			// the file, or -1 if the slot is free
+    VoidFunctionPtr handler;	// who to tell when it has input
+    int arg;			// and what to tell them
+    bool armed;			// TRUE if they are waiting to be told
+    bool registered;		// TRUE if epoll knows about the file
+};
+
+static WatchedFile watched[MaxWatchedFiles];
+static int numWatched = 0;	// how many slots have been used
+static int numArmed = 0;	// how many files are armed
+#ifdef __linux__
+static int epollFd = -1;	// the epoll instance, once we need one
+#endif
+
+//----------------------------------------------------------------------
+// FindWatched
+// 	Find the slot in the table of watched files for "fd", and
+//	if "create", make one if there isn't one already.
+//----------------------------------------------------------------------
+
+static WatchedFile *
+FindWatched(int fd, bool create)
+{
+    WatchedFile *free = NULL;
+
+    for (int i = 0; i < numWatched; i++) {
+	if (watched[i].fd == fd)
+	    return &watched[i];
+	if (watched[i].fd == -1 && free == NULL)
+	    free = &watched[i];
+    }
+    if (!create)
+	return NULL;
+    if (free == NULL) {
+	ASSERT(numWatched < MaxWatchedFiles);
+	free = &watched[numWatched++];
+    }
+    free->fd = fd;
+    free->armed = FALSE;
+    free->registered = FALSE;
+    return free;
+}
+
+//----------------------------------------------------------------------
+// WatchFile
+// 	Ask to be told, once, when there are characters to be read on
+//	an open file or socket: the next PollFiles after they arrive
+//	calls "handler", with "arg".  To be told again, call WatchFile
+//	again.
+//
+//	On Linux, the files are watched with epoll, which won't watch
+//	ordinary files; since they always have something to read (if 
+//	only the end of file), "handler" is called right away.
+//	Elsewhere, we make do with poll.
+//
+//	"fd" -- the file descriptor of the file to watch
+//	"handler" -- the routine to call when it is ready
+//	"arg" -- what to pass it
+//----------------------------------------------------------------------
+
+void
+WatchFile(int fd, VoidFunctionPtr handler, int arg)
+{
+    WatchedFile *file = FindWatched(fd, TRUE);
+
+    file->handler = handler;
+    file->arg = arg;
+    if (file->armed)
+	return;
+#ifdef __linux__
+    struct epoll_event event;
+
+    if (epollFd < 0) {
+	epollFd = epoll_create(MaxWatchedFiles);
+	ASSERT(epollFd >= 0);
+    }
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.u32 = file - watched;
+    if (epoll_ctl(epollFd, file->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+						fd, &event) < 0) {
+	ASSERT(errno == EPERM);		// an ordinary file
+	(*handler)(arg);
+	return;
+    }
+    file->registered = TRUE;
+#endif
+    file->armed = TRUE;
+    numArmed++;
+}
+
+//----------------------------------------------------------------------
+// IgnoreFile
+// 	Stop watching an open file, before it is closed.
+//
+//	"fd" -- the file descriptor of the file
+//----------------------------------------------------------------------
+
+void
+IgnoreFile(int fd)
+{
+    WatchedFile *file = FindWatched(fd, FALSE);
+
+    if (file == NULL)
+	return;
+    if (file->armed)
+	numArmed--;
+#ifdef __linux__
+    if (file->registered)
+	(void) epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+    file->fd = -1;
+}
+
+//----------------------------------------------------------------------
+// FilesWatched
+// 	Return how many files we are waiting to hear from.
+//----------------------------------------------------------------------
+
+int
+FilesWatched()
+{
+    return numArmed;
+}
+
+//----------------------------------------------------------------------
+// PollFiles
+// 	Call the handler of each watched file that has characters to
+//	be read.  If "wait", and none do, wait until one does (this is
+//	how an idle Nachos waits for input, without using the host's
+//	CPU); otherwise, return right away.
+//
+//	"wait" -- TRUE if we should block until some file is ready
+//----------------------------------------------------------------------
+
+void
+PollFiles(bool wait)
+{
+    WatchedFile *ready[MaxWatchedFiles];
+    int numReady = 0, retVal;
+
+    if (numArmed == 0)
+	return;
+#ifdef __linux__
+    struct epoll_event events[MaxWatchedFiles];
+
+    do {
+	retVal = epoll_wait(epollFd, events, MaxWatchedFiles, wait ? -1 : 0);
+    } while (retVal < 0 && errno == EINTR);
+    ASSERT(retVal >= 0);
+    for (int i = 0; i < retVal; i++)
+	ready[numReady++] = &watched[events[i].data.u32];
+#else
+    struct pollfd fds[MaxWatchedFiles];
+    WatchedFile *polled[MaxWatchedFiles];
+    int numPolled = 0;
+
+    for (int i = 0; i < numWatched; i++)
+	if (watched[i].fd != -1 && watched[i].armed) {
+	    fds[numPolled].fd = watched[i].fd;
+	    fds[numPolled].events = POLLIN;
+	    polled[numPolled++] = &watched[i];
+	}
+    do {
+	retVal = poll(fds, numPolled, wait ? -1 : 0);
+    } while (retVal < 0 && errno == EINTR);
+    ASSERT(retVal >= 0);
+    for (int i = 0; i < numPolled; i++)
+	if (fds[i].revents != 0)
+	    ready[numReady++] = polled[i];
+#endif
+
+// disarm them all first, since the handlers may re-arm them
+    for (int i = 0; i < numReady; i++) {
+	if (!ready[i]->armed) {
+	    ready[i] = NULL;
+	    continue;
+	}
+	ready[i]->armed = FALSE;
+	numArmed--;
+    }
+    for (int i = 0; i < numReady; i++)
+	if (ready[i] != NULL)
+	    (*ready[i]->handler)(ready[i]->arg);
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -403,6 +603,20 @@ CallOnUserAbort(VoidNoArgFunctionPtr func)
     (void)signal(SIGINT, (VoidFunctionPtr) func);
 }
 
+//----------------------------------------------------------------------
+// CallOnAbort
+// 	Arrange that "func" will be called when Nachos aborts (e.g., on
+//	a failed ASSERT), before it drops core.
+//----------------------------------------------------------------------
+
+static VoidNoArgFunctionPtr abortFunc = NULL;
+
+void 
+CallOnAbort(VoidNoArgFunctionPtr func)
+{
+    abortFunc = func;
+}
+
 //----------------------------------------------------------------------
 // Sleep
 // 	Put the UNIX process running Nachos to sleep for x seconds,
@@ -418,12 +632,18 @@ Delay(int seconds)
 
 //----------------------------------------------------------------------
 // Abort
-// 	Quit and drop core.
+// 	Quit and drop core, calling the function given to CallOnAbort
+//	first, if any.
 //----------------------------------------------------------------------
 
 void 
 Abort()
 {
+    VoidNoArgFunctionPtr func = abortFunc;
+
+    abortFunc = NULL;			// in case it aborts too
+    if (func != NULL)
+	(*func)();
     abort();
 }
 
@@ -461,6 +681,130 @@ Random()
     return rand();
 }
 
+//----------------------------------------------------------------------
+// HostThreadLoop
+// 	The body of each host thread started by StartHostThreads: wait
+//	for RunHostThreads to hand out work, do it, and report back.  The
+//	work comes in short bursts, and sleeping and waking up can take
+//	longer than the work itself, so we wait by spinning (politely) at
+//	first.  But if no work comes for HostSpins tries -- Nachos is
+//	idle, say, or running kernel code on one CPU -- we go to sleep 
+//	until it does, rather than keep a host CPU busy doing nothing.
+//
+//	"arg" -- the number of this host thread
+//----------------------------------------------------------------------
+
+#define HostSpins	2000		// how long to spin before sleeping
+
+static VoidFunctionPtr hostFunc;	// what the host threads are to do
+static int hostCount;			// how many there are, with the caller
+static volatile int hostRound;		// bumped to hand out work
+static volatile int hostBusy;		// threads yet to finish the round
+static pthread_mutex_t hostMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hostStart = PTHREAD_COND_INITIALIZER;
+					// signalled when work is handed out
+static pthread_cond_t hostDone = PTHREAD_COND_INITIALIZER;
+					// and when the round is over
+
+static void *
+HostThreadLoop(void *arg)
+{
+    int which = (int) (long) arg;
+    int seen = 0, spins;
+
+    for (;;) {
+	for (spins = 0; hostRound == seen && spins < HostSpins; spins++)
+	    if (spins > 100)
+		sched_yield();
+	if (hostRound == seen) {	// nothing yet; sleep until there is
+	    pthread_mutex_lock(&hostMutex);
+	    while (hostRound == seen)
+		pthread_cond_wait(&hostStart, &hostMutex);
+	    pthread_mutex_unlock(&hostMutex);
+	}
+	seen = hostRound;
+	__sync_synchronize();
+	(*hostFunc)(which);
+	if (__sync_sub_and_fetch(&hostBusy, 1) == 0) { // the last one 
+	    pthread_mutex_lock(&hostMutex);	       // done wakes up
+	    pthread_cond_signal(&hostDone);	       // RunHostThreads,
+	    pthread_mutex_unlock(&hostMutex);	       // if it is asleep
+	}
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// StartHostThreads
+// 	Start the host threads used by RunHostThreads.  The calling 
+//	thread counts as one of them.  Call only once.
+//
+//	"count" -- the number of host threads, including the caller
+//	"func" -- the routine each runs, passed the number of the thread
+//----------------------------------------------------------------------
+
+void
+StartHostThreads(int count, VoidFunctionPtr func)
+{
+    pthread_t id;
+
+    ASSERT(count > 0 && hostCount == 0);
+    hostFunc = func;
+    hostCount = count;
+    for (int i = 1; i < count; i++) {
+	int retVal = pthread_create(&id, NULL, HostThreadLoop, 
+					(void *) (long) i);
+	ASSERT(retVal == 0);
+	pthread_detach(id);
+    }
+}
+
+//----------------------------------------------------------------------
+// RunHostThreads
+// 	Call the routine passed to StartHostThreads on each host thread,
+//	and wait for them all to finish -- spinning, and then, if they
+//	take long, sleeping, as HostThreadLoop does.
+//----------------------------------------------------------------------
+
+void
+RunHostThreads()
+{
+    int spins;
+
+    ASSERT(hostCount > 0);
+    hostBusy = hostCount - 1;
+    __sync_synchronize();
+    pthread_mutex_lock(&hostMutex);
+    hostRound++;			// off they go, waking up any
+    pthread_cond_broadcast(&hostStart);	// that are asleep
+    pthread_mutex_unlock(&hostMutex);
+    (*hostFunc)(0);
+    for (spins = 0; hostBusy > 0 && spins < HostSpins; spins++)
+	if (spins > 100)
+	    sched_yield();
+    if (hostBusy > 0) {
+	pthread_mutex_lock(&hostMutex);
+	while (hostBusy > 0)
+	    pthread_cond_wait(&hostDone, &hostMutex);
+	pthread_mutex_unlock(&hostMutex);
+    }
+    __sync_synchronize();
+}
+
+//----------------------------------------------------------------------
+// HostTime
+// 	Return the time of day on the host, in seconds.
+//----------------------------------------------------------------------
+
+double
+HostTime()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // AllocBoundedArray
 // 	Return an array, with the two pages just before 
@@ -17,6 +17,14 @@
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Watching files for input, so that we don't have to keep checking.
+// WatchFile asks for "handler" to be called, once, by the first 
+// PollFiles to find "fd" ready to read.  PollFiles can wait until then.
+extern void WatchFile(int fd, VoidFunctionPtr handler, int arg);
+extern void IgnoreFile(int fd);
+extern int FilesWatched();
+extern void PollFiles(bool wait);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
@@ -46,10 +54,22 @@ extern void Delay(int seconds);
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
+// Arrange that "func" is called when Nachos aborts, before dumping core
+extern void CallOnAbort(VoidNoArgFunctionPtr func);
+
 // Initialize the pseudo random number generator
 extern void RandomInit(unsigned seed);
 extern int Random();
 
+// Host threads, for simulating several CPUs at once.  Each call to 
+// RunHostThreads calls "func" once on each host thread (the caller is 
+// number 0), and returns when they are all done.
+extern void StartHostThreads(int count, VoidFunctionPtr func);
+extern void RunHostThreads();
+
+// Wall clock time on the host, in seconds
+extern double HostTime();
+
 // Allocate, de-allocate an array, such that de-referencing
 // just beyond either end of the array will cause an error
 extern char *AllocBoundedArray(int size);
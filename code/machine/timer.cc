@@ -1,14 +1,16 @@
 // timer.cc 
 //	Routines to emulate a hardware timer device.
 //
-//      A hardware timer generates a CPU interrupt every X milliseconds.
+//      A hardware timer generates a CPU interrupt after X milliseconds.
 //      This means it can be used for implementing time-slicing.
 //
 //      We emulate a hardware timer by scheduling an interrupt to occur
-//      every time stats->totalTicks has increased by TimerTicks.
+//      when stats->totalTicks reaches the time the alarm was set for;
+//	setting it again cancels that interrupt, and schedules another.
 //
 //      In order to introduce some randomness into time-slicing, if "doRandom"
-//      is set, then the interrupt is comes after a random number of ticks.
+//      is set, then the interrupt comes over and over, each time after 
+//	a random number of ticks.
 //
 //	Remember -- nothing in here is part of Nachos.  It is just
 //	an emulation for the hardware that Nachos is running on top of.
@@ -31,7 +33,8 @@ static void TimerHandler(int arg)
 // Timer::Timer
 //      Initialize a hardware timer device.  Save the place to call
 //	on each interrupt, and then arrange for the timer to start
-//	generating interrupts.
+//	generating interrupts.  Unless it goes off at random, it goes
+//	off just once, after TimerTicks, unless the alarm is set.
 //
 //      "timerHandler" is the interrupt handler for the timer device.
 //		It is called with interrupts disabled every time the
@@ -48,22 +51,65 @@ Timer::Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom)
     arg = callArg; 
 
     // schedule the first interrupt from the timer device
-    interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
-		TimerInt); 
+    next = interrupt->Schedule(TimerHandler, (int) this, 
+			       TimeOfNextInterrupt(), TimerInt); 
+}
+
+//----------------------------------------------------------------------
+// Timer::~Timer
+//      Turn off the timer device.
+//----------------------------------------------------------------------
+
+Timer::~Timer()
+{
+    if (next != NULL)
+	(void) interrupt->Cancel(next);
+}
+
+//----------------------------------------------------------------------
+// Timer::SetAlarm
+//      Arrange for the timer to go off "ticks" from now, and not before.
+//	If it was going to go off at some other time, it no longer will.
+//	A timer that goes off at random ignores this.
+//
+//	With several CPUs, each has an alarm of its own (see 
+//	Interrupt::SetCPUTimer), and this sets the current CPU's.
+//
+//	"ticks" is how long from now the interrupt is to occur
+//----------------------------------------------------------------------
+
+void
+Timer::SetAlarm(int ticks)
+{
+    if (randomize)
+	return;
+    if (interrupt->CPUTimers()) {
+	if (next != NULL) {		// the alarm set before there were
+	    (void) interrupt->Cancel(next); // several CPUs
+	    next = NULL;
+	}
+	interrupt->SetCPUTimer(TimerHandler, (int) this, ticks);
+	return;
+    }
+    if (next == NULL || !interrupt->Reschedule(next, ticks))
+	next = interrupt->Schedule(TimerHandler, (int) this, ticks, TimerInt);
 }
 
 //----------------------------------------------------------------------
 // Timer::TimerExpired
 //      Routine to simulate the interrupt generated by the hardware 
-//	timer device.  Schedule the next interrupt, and invoke the
-//	interrupt handler.
+//	timer device.  If it goes off at random, schedule the next 
+//	interrupt.  Then invoke the interrupt handler, which may set 
+//	the alarm again.
 //----------------------------------------------------------------------
 void 
 Timer::TimerExpired() 
 {
     // schedule the next timer device interrupt
-    interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
-		TimerInt);
+    next = NULL;
+    if (randomize)
+	next = interrupt->Schedule(TimerHandler, (int) this, 
+				   TimeOfNextInterrupt(), TimerInt);
 
     // invoke the Nachos interrupt handler for this device
     (*handler)(arg);
@@ -72,14 +118,19 @@ Timer::TimerExpired()
 //----------------------------------------------------------------------
 // Timer::TimeOfNextInterrupt
 //      Return when the hardware timer device will next cause an interrupt.
-//	If randomize is turned on, make it a (pseudo-)random delay.
+//	If randomize is turned on, make it a (pseudo-)random delay -- or
+//	when replaying a run, the delay there was then (see replay.h).
 //----------------------------------------------------------------------
 
 int 
 Timer::TimeOfNextInterrupt() 
 {
-    if (randomize)
-	return 1 + (Random() % (TimerTicks * 2));
-    else
+    int delay;
+
+    if (!randomize)
 	return TimerTicks; 
+    delay = 1 + (Random() % (TimerTicks * 2));
+    if (replayLog != NULL)		// log it, or use the one logged
+	delay = replayLog->Delay(delay);
+    return delay;
 }
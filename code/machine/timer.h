@@ -1,15 +1,21 @@
 // timer.h 
 //	Data structures to emulate a hardware timer.
 //
-//	A hardware timer generates a CPU interrupt every X milliseconds.
+//	A hardware timer generates a CPU interrupt after X milliseconds.
 //	This means it can be used for implementing time-slicing, or for
 //	having a thread go to sleep for a specific period of time. 
 //
-//	We emulate a hardware timer by scheduling an interrupt to occur
-//	every time stats->totalTicks has increased by TimerTicks.
+//	We emulate a one-shot timer: the kernel sets the alarm each time
+//	it gives a thread the CPU (SetAlarm), and there is no interrupt 
+//	until the time is up -- none at all, if the alarm is set again 
+//	first.  So a thread that gives up the CPU before its time slice
+//	is over is never interrupted.  To start with, the alarm is set
+//	for TimerTicks.  With several CPUs, each CPU has an alarm of its
+//	own, set by the thread running there.
 //
 //	In order to introduce some randomness into time-slicing, if "doRandom"
-//	is set, then the interrupt comes after a random number of ticks.
+//	is set, then the timer instead goes off over and over, each time
+//	after a random number of ticks, and ignores SetAlarm.
 //
 //  DO NOT CHANGE -- part of the machine emulation
 //
@@ -23,13 +29,18 @@
 #include "copyright.h"
 #include "utility.h"
 
+class PendingInterrupt;
+
 // The following class defines a hardware timer. 
 class Timer {
   public:
     Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom);
 				// Initialize the timer, to call the interrupt
 				// handler "timerHandler" every time slice.
-    ~Timer() {}
+    ~Timer();
+
+    void SetAlarm(int ticks);	// Go off "ticks" from now, instead of
+				// whenever the timer was going to
 
 // Internal routines to the timer emulation -- DO NOT call these
 
@@ -43,6 +54,7 @@ class Timer {
     bool randomize;		// set if we need to use a random timeout delay
     VoidFunctionPtr handler;	// timer interrupt handler 
     int arg;			// argument to pass to interrupt handler
+    PendingInterrupt *next;	// the interrupt to come, if any
 
 };
 
@@ -23,6 +23,10 @@
 //	Note that the contents of the TLB are specific to an address space.
 //	If the address space changes, so does the contents of the TLB!
 //
+//	Either way, successful translations are also cached in a "soft
+//	TLB" (see machine.h), so that most loads and stores can go
+//	straight to mainMemory without calling Translate.
+//
 // DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -71,6 +75,91 @@ unsigned short
 ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 
 
+//----------------------------------------------------------------------
+// Machine::LookupSoftTLB
+// 	Look for a virtual address in one of the soft TLBs.  Return the
+//	entry if it maps the address's page, and the access is aligned,
+//	or NULL if we have to go the slow way.
+//
+//	"table" -- softRead or softWrite
+//	"virtAddr" -- the virtual address to translate
+//	"size" -- the amount of memory being read or written
+//----------------------------------------------------------------------
+
+SoftTLBEntry *
+Machine::LookupSoftTLB(SoftTLBEntry *table, int virtAddr, int size)
+{
+    int vpn = (unsigned) virtAddr >> PageShift;
+    SoftTLBEntry *entry = &table[vpn & (SoftTLBSize - 1)];
+
+    if (entry->virtualPage != vpn || (virtAddr & (size - 1)))
+	return NULL;
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// Machine::FillSoftTLB
+// 	Remember a translation that Translate has just made (and has set
+//	the use and dirty bits for).  Not done when we're debugging
+//	address translation, so the slow path still prints everything.
+//
+//	"table" -- softRead or softWrite
+//	"virtAddr" -- the virtual address that was translated
+//	"physAddr" -- the physical address it translated to
+//----------------------------------------------------------------------
+
+void
+Machine::FillSoftTLB(SoftTLBEntry *table, int virtAddr, int physAddr)
+{
+    int vpn = (unsigned) virtAddr >> PageShift;
+    SoftTLBEntry *entry = &table[vpn & (SoftTLBSize - 1)];
+
+    if (DebugIsEnabled('a'))
+	return;
+    entry->virtualPage = vpn;
+    entry->physicalPage = physAddr >> PageShift;
+    entry->memory = &mainMemory[entry->physicalPage * PageSize];
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushSoftTLB
+// 	Forget every soft TLB entry.  Called whenever the page table or
+//	TLB may have changed.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushSoftTLB()
+{
+    for (int i = 0; i < SoftTLBSize; i++) {
+	softRead[i].virtualPage = -1;
+	softWrite[i].virtualPage = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::QuickTranslate
+// 	Translate a virtual address, using the soft TLB if we can;
+//	otherwise, the same as Translate.
+//----------------------------------------------------------------------
+
+ExceptionType
+Machine::QuickTranslate(int virtAddr, int* physAddr, int size, bool writing)
+{
+    SoftTLBEntry *table = writing ? softWrite : softRead;
+    SoftTLBEntry *entry = LookupSoftTLB(table, virtAddr, size);
+    ExceptionType exception;
+
+    if (entry != NULL) {
+	*physAddr = entry->physicalPage * PageSize 
+				+ ((unsigned) virtAddr & (PageSize - 1));
+	return NoException;
+    }
+    exception = Translate(virtAddr, physAddr, size, writing);
+    if (exception == NoException)
+	FillSoftTLB(table, virtAddr, *physAddr);
+    return exception;
+}
+
 //----------------------------------------------------------------------
 // Machine::ReadMem
 //      Read "size" (1, 2, or 4) bytes of virtual memory at "addr" into 
@@ -90,27 +179,45 @@ Machine::ReadMem(int addr, int size, int *value)
     int data;
     ExceptionType exception;
     int physicalAddress;
+    SoftTLBEntry *entry = LookupSoftTLB(softRead, addr, size);
+    char *hostAddress;
+
+    if (entry != NULL) {		// fast path: no checks needed
+	hostAddress = entry->memory + ((unsigned) addr & (PageSize - 1));
+	switch (size) {
+	  case 1:
+	    *value = *hostAddress;
+	    return TRUE;
+	  case 2:
+	    *value = ShortToHost(*(unsigned short *) hostAddress);
+	    return TRUE;
+	  case 4:
+	    *value = WordToHost(*(unsigned int *) hostAddress);
+	    return TRUE;
+	}
+    }
     
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
     exception = Translate(addr, &physicalAddress, size, FALSE);
     if (exception != NoException) {
-	machine->RaiseException(exception, addr);
+	RaiseException(exception, addr);
 	return FALSE;
     }
+    FillSoftTLB(softRead, addr, physicalAddress);
     switch (size) {
       case 1:
-	data = machine->mainMemory[physicalAddress];
+	data = mainMemory[physicalAddress];
 	*value = data;
 	break;
 	
       case 2:
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned short *) &mainMemory[physicalAddress];
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned int *) &mainMemory[physicalAddress];
 	*value = WordToHost(data);
 	break;
 
@@ -139,31 +246,53 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    SoftTLBEntry *entry = LookupSoftTLB(softWrite, addr, size);
+    char *hostAddress;
+
+    if (entry != NULL) {		// fast path: no checks needed
+	hostAddress = entry->memory + ((unsigned) addr & (PageSize - 1));
+	switch (size) {
+	  case 1:
+	    *hostAddress = (unsigned char) (value & 0xff);
+	    break;
+	  case 2:
+	    *(unsigned short *) hostAddress
+		= ShortToMachine((unsigned short) (value & 0xffff));
+	    break;
+	  case 4:
+	    *(unsigned int *) hostAddress = WordToMachine((unsigned int) value);
+	    break;
+	}
+	WordWritten(hostAddress - mainMemory);	// in case it's code
+	return TRUE;
+    }
      
     DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
     exception = Translate(addr, &physicalAddress, size, TRUE);
     if (exception != NoException) {
-	machine->RaiseException(exception, addr);
+	RaiseException(exception, addr);
 	return FALSE;
     }
+    FillSoftTLB(softWrite, addr, physicalAddress);
     switch (size) {
       case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
 	break;
 
       case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
+	*(unsigned short *) &mainMemory[physicalAddress]
 		= ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       
       case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
+	*(unsigned int *) &mainMemory[physicalAddress]
 		= WordToMachine((unsigned int) value);
 	break;
 	
       default: ASSERT(FALSE);
     }
+    WordWritten(physicalAddress);			// in case it's code
     
     return TRUE;
 }
@@ -205,8 +334,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
-    vpn = (unsigned) virtAddr / PageSize;
-    offset = (unsigned) virtAddr % PageSize;
+    vpn = (unsigned) virtAddr >> PageShift;
+    offset = (unsigned) virtAddr & (PageSize - 1);
     
     if (tlb == NULL) {		// => page table => vpn is index into table
 	if (vpn >= pageTableSize) {
@@ -221,7 +350,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	entry = &pageTable[vpn];
     } else {
         for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
+    	    if (tlb[i].valid && ((unsigned int) tlb[i].virtualPage == vpn)) {
 		entry = &tlb[i];			// FOUND!
 		break;
 	    }
@@ -241,7 +370,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned int) NumPhysPages) {
 	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
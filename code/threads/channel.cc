@@ -0,0 +1,230 @@
+// channel.cc
+//	Routines for a bounded channel between threads.  See channel.h.
+//
+//	Since Channel is a template, this file isn't compiled by
+//	itself; channel.h includes it.
+//
+// 	Implemented in "monitor"-style, like SynchList: a lock protects
+//	the ring, and senders and receivers wait on condition variables.
+//	To save waking them up for nothing, senders only signal the
+//	receivers once there are as many items as some receiver asked
+//	for (wakeAt), and receivers only signal the senders if any are
+//	waiting for room.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "channel.h"
+
+//----------------------------------------------------------------------
+// Channel::Channel
+//	Initialize an empty channel.
+//
+//	"debugName" is an arbitrary name, useful for debugging; it is
+//		also the name of the channel's lock.
+//	"size" is how many items the channel can hold.
+//----------------------------------------------------------------------
+
+template <class T>
+Channel<T>::Channel(char *debugName, int size)
+{
+    ASSERT(size > 0);
+    name = debugName;
+    capacity = size;
+    buffer = new T *[capacity];
+    first = count = 0;
+    lock = new Lock(debugName);
+    notEmpty = new Condition(debugName);
+    notFull = new Condition(debugName);
+    wakeAt = capacity + 1;		// no one is waiting
+    sendersWaiting = 0;
+}
+
+//----------------------------------------------------------------------
+// Channel::~Channel
+//	De-allocate a channel.  Any items left in it belong to someone
+//	else.
+//----------------------------------------------------------------------
+
+template <class T>
+Channel<T>::~Channel()
+{
+    delete [] buffer;
+    delete lock;
+    delete notEmpty;
+    delete notFull;
+}
+
+//----------------------------------------------------------------------
+// Channel::Put
+//	Put an item on the end of the ring, which must have room for it.
+//	If that makes as many items as a waiting receiver asked for,
+//	wake up all the receivers; they each check again, and those
+//	that still want more say so.
+//
+//	Called with the lock held.
+//
+//	"item" is the thing to put in the channel.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Channel<T>::Put(T *item)
+{
+    ASSERT(count < capacity);
+    buffer[(first + count) % capacity] = item;
+    count++;
+    if (count >= wakeAt) {
+	wakeAt = capacity + 1;
+	notEmpty->Broadcast(lock);
+    }
+}
+
+//----------------------------------------------------------------------
+// Channel::Take
+//	Take items off the front of the ring.  If any senders are waiting
+//	for room, wake them up.
+//
+//	Called with the lock held.
+//
+//	"items" is where to put them.
+//	"atMost" is how many to take, if there are that many.
+//
+// Returns:
+//	How many items were taken.
+//----------------------------------------------------------------------
+
+template <class T>
+int
+Channel<T>::Take(T **items, int atMost)
+{
+    int n = (count < atMost) ? count : atMost;
+
+    for (int i = 0; i < n; i++) {
+	items[i] = buffer[first];
+	first = (first + 1) % capacity;
+    }
+    count -= n;
+    if (n > 0 && sendersWaiting > 0)
+	notFull->Broadcast(lock);
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Channel::Send
+//      Put an item on the end of the channel, waiting until there is
+//	room for it.
+//
+//	"item" is the thing to put in the channel.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Channel<T>::Send(T *item)
+{
+    lock->Acquire();
+    while (count == capacity) {
+	sendersWaiting++;
+	notFull->Wait(lock);
+	sendersWaiting--;
+    }
+    Put(item);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Channel::TrySend
+//      Put an item on the end of the channel, if there is room for it.
+//
+//	"item" is the thing to put in the channel.
+//
+// Returns:
+//	FALSE if the channel was full.
+//----------------------------------------------------------------------
+
+template <class T>
+bool
+Channel<T>::TrySend(T *item)
+{
+    bool sent = FALSE;
+
+    lock->Acquire();
+    if (count < capacity) {
+	Put(item);
+	sent = TRUE;
+    }
+    lock->Release();
+    return sent;
+}
+
+//----------------------------------------------------------------------
+// Channel::ReceiveBatch
+//      Take items off the front of the channel, waiting until there
+//	are enough of them.
+//
+//	"items" is where to put them; it must have room for "atMost".
+//	"atLeast" is how many to wait for; no more than the channel holds.
+//	"atMost" is how many to take, if there are that many.
+//
+// Returns:
+//	How many items were taken.
+//----------------------------------------------------------------------
+
+template <class T>
+int
+Channel<T>::ReceiveBatch(T **items, int atLeast, int atMost)
+{
+    int n;
+
+    ASSERT(atLeast > 0 && atLeast <= capacity && atLeast <= atMost);
+    lock->Acquire();
+    while (count < atLeast) {
+	if (atLeast < wakeAt)
+	    wakeAt = atLeast;
+	notEmpty->Wait(lock);
+    }
+    n = Take(items, atMost);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Channel::Receive
+//      Take the item off the front of the channel, waiting until there
+//	is one.
+//
+// Returns:
+//	The item.
+//----------------------------------------------------------------------
+
+template <class T>
+T *
+Channel<T>::Receive()
+{
+    T *item;
+
+    (void) ReceiveBatch(&item, 1, 1);
+    return item;
+}
+
+//----------------------------------------------------------------------
+// Channel::TryReceive
+//      Take the item off the front of the channel, if there is one.
+//
+// Returns:
+//	The item, or NULL if the channel was empty.
+//----------------------------------------------------------------------
+
+template <class T>
+T *
+Channel<T>::TryReceive()
+{
+    T *item = NULL;
+
+    lock->Acquire();
+    (void) Take(&item, 1);
+    lock->Release();
+    return item;
+}
@@ -0,0 +1,79 @@
+// channel.h
+//	Data structures for a bounded channel: a queue of items passed
+//	from one set of threads (senders) to another (receivers).
+//
+//	Unlike a SynchList, a channel holds at most a fixed number of
+//	items, in a ring buffer.  A sender waits while it is full, so a
+//	fast sender can't get arbitrarily far ahead of a slow receiver
+//	("back-pressure").  Or it can try to send without waiting, and
+//	find out whether there was room.
+//
+//	A receiver can take several items at once, and ask not to be
+//	woken up until there are enough of them: so a consumer that
+//	handles items in batches costs a couple of context switches for
+//	each batch, rather than for each item.
+//
+//	Like SynchList, a Channel<T> holds pointers to items of class T;
+//	unlike it, the items needn't have a link.  As with all things built
+//	on Locks, it must not be used by interrupt handlers.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "copyright.h"
+#include "synch.h"
+
+// The following class defines a bounded channel.
+
+template <class T>
+class Channel {
+  public:
+    Channel(char *debugName, int size);	// initialize an empty channel,
+					// with room for "size" items
+    ~Channel();				// de-allocate it
+
+    void Send(T *item);			// put an item on the end, waiting
+					// until there is room
+    bool TrySend(T *item);		// the same, but FALSE instead of
+					// waiting, if there isn't room
+
+    T *Receive();			// take the item at the front,
+					// waiting until there is one
+    T *TryReceive();			// the same, but NULL instead of
+					// waiting, if there isn't one
+    int ReceiveBatch(T **items, int atLeast, int atMost);
+					// take up to "atMost" items, waiting
+					// until there are "atLeast";
+					// returns how many
+
+    int NumItems() { return count; }	// how many are waiting to be
+					// received, a moment ago
+
+  private:
+    char *name;				// useful for debugging
+    T **buffer;				// the items, in a ring
+    int capacity;			// how many the ring has room for
+    int first;				// where the next one to receive is
+    int count;				// how many it holds
+
+    Lock *lock;				// enforce mutual exclusive access
+    Condition *notEmpty;		// receivers wait here for items,
+    Condition *notFull;			// and senders for room
+    int wakeAt;				// how many items the receivers
+					// want before they are woken up
+    int sendersWaiting;			// how many senders wait for room
+
+    void Put(T *item);			// Put an item in the ring, and wake
+					// the receivers if there are enough
+    int Take(T **items, int atMost);	// Take items out, and wake up the
+					// senders, if any
+};
+
+#include "channel.cc"			// the routines are templates, so
+					// every user of a Channel needs them
+
+#endif // CHANNEL_H
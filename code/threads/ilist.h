@@ -0,0 +1,188 @@
+// ilist.h
+//	Data structures to manage intrusive lists -- doubly linked lists
+//	whose links are kept in the items on the list, rather than in
+//	ListElements allocated for them.  So putting an item on a list,
+//	or taking it off (from anywhere on the list), never allocates
+//	any memory, and takes constant time.
+//
+//	The catch is that an item can only be on one such list at a
+//	time.  That suits the kernel's queues: a thread is either on the
+//	ready list, or waiting on a single semaphore, or neither; a
+//	message is in one mailbox.
+//
+//	To go on an IList<T>, a T needs a public member
+//	"ListLink<T> link".  The list doesn't own its items; whoever
+//	puts an item on a list is responsible for de-allocating it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef ILIST_H
+#define ILIST_H
+
+#include "copyright.h"
+#include "utility.h"
+
+template <class T> class IList;
+
+// The following class defines the links kept in each item of an
+// intrusive list.  Internal data structures kept public so that IList
+// operations can access them directly.
+
+template <class T>
+class ListLink {
+  public:
+    ListLink() { prev = NULL; next = NULL; list = NULL; }
+
+    T *prev;			// previous item on the list,
+				// NULL if this is the first
+    T *next;			// next item on the list,
+				// NULL if this is the last
+    IList<T> *list;		// the list the item is on, if any
+};
+
+// The following class defines an intrusive list of items of class T.
+
+template <class T>
+class IList {
+  public:
+    IList() { first = NULL; last = NULL; numItems = 0; }
+				// initialize the list
+    ~IList() {}			// de-allocate the list (but not the
+				// items left on it)
+
+    void Prepend(T *item); 	// Put item at the beginning of the list
+    void Append(T *item); 	// Put item at the end of the list
+    T *Remove(); 	 	// Take item off the front of the list,
+				// or return NULL if it is empty
+    bool Remove(T *item);	// Take "item" off the list, wherever it
+				// is; FALSE if it wasn't on the list
+
+    T *First() { return first; }	// The item at the front, if any
+    T *Next(T *item) { return item->link.next; }
+				// The one after "item", if any
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every item
+					// on the list
+    bool IsEmpty() { return (first == NULL); }
+    int NumItems() { return numItems; }
+
+  private:
+    T *first;			// Head of the list, NULL if list is empty
+    T *last;			// Last item on the list
+    int numItems;		// how many items are on the list
+};
+
+// The list operations are short, so they are all defined here,
+// where every user of the template can see them.
+
+//----------------------------------------------------------------------
+// IList<T>::Prepend
+//      Put an "item" on the front of the list.  It mustn't already be
+//	on a list.
+//----------------------------------------------------------------------
+
+template <class T>
+inline void
+IList<T>::Prepend(T *item)
+{
+    ASSERT(item->link.list == NULL);
+    item->link.list = this;
+    item->link.prev = NULL;
+    item->link.next = first;
+    if (first == NULL)
+	last = item;
+    else
+	first->link.prev = item;
+    first = item;
+    numItems++;
+}
+
+//----------------------------------------------------------------------
+// IList<T>::Append
+//      Put an "item" on the end of the list.  It mustn't already be
+//	on a list.
+//----------------------------------------------------------------------
+
+template <class T>
+inline void
+IList<T>::Append(T *item)
+{
+    ASSERT(item->link.list == NULL);
+    item->link.list = this;
+    item->link.prev = last;
+    item->link.next = NULL;
+    if (last == NULL)
+	first = item;
+    else
+	last->link.next = item;
+    last = item;
+    numItems++;
+}
+
+//----------------------------------------------------------------------
+// IList<T>::Remove
+//      Take the first item off the front of the list.
+//
+// Returns:
+//	The item, or NULL if the list was empty.
+//----------------------------------------------------------------------
+
+template <class T>
+inline T *
+IList<T>::Remove()
+{
+    T *item = first;
+
+    if (item != NULL)
+	(void) Remove(item);
+    return item;
+}
+
+//----------------------------------------------------------------------
+// IList<T>::Remove
+//      Take an "item" off the list, wherever it is on it.
+//
+// Returns:
+//	FALSE if the item wasn't on this list.
+//----------------------------------------------------------------------
+
+template <class T>
+inline bool
+IList<T>::Remove(T *item)
+{
+    if (item->link.list != this)
+	return FALSE;
+    if (item->link.prev == NULL)
+	first = item->link.next;
+    else
+	item->link.prev->link.next = item->link.next;
+    if (item->link.next == NULL)
+	last = item->link.prev;
+    else
+	item->link.next->link.prev = item->link.prev;
+    item->link.prev = NULL;
+    item->link.next = NULL;
+    item->link.list = NULL;
+    numItems--;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// IList<T>::Mapcar
+//	Apply a function to each item on the list, from the front.
+//
+//	"func" is the procedure to apply to each item on the list.
+//----------------------------------------------------------------------
+
+template <class T>
+inline void
+IList<T>::Mapcar(VoidFunctionPtr func)
+{
+    for (T *item = first; item != NULL; item = item->link.next) {
+       DEBUG('l', "In mapcar, about to invoke %x(%x)\n", func, item);
+       (*func)((int)item);
+    }
+}
+
+#endif // ILIST_H
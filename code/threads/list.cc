@@ -27,8 +27,11 @@
 //	"sortKey" is the priority of the item, if any.
 //----------------------------------------------------------------------
 
+int ListElement::numCreated = 0;
+
 ListElement::ListElement(void *itemPtr, int sortKey)
 {
+     numCreated++;
      item = itemPtr;
      key = sortKey;
      next = NULL;	// assume we'll put it at the end of the list 
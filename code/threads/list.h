@@ -32,6 +32,9 @@ class ListElement {
 				// NULL if this is the last
      int key;		    	// priority, for a sorted list
      void *item; 	    	// pointer to item on the list
+
+     static int numCreated;	// how many have been allocated, ever
+				// (see ListBenchmark in threadtest.cc)
 };
 
 // The following class defines a "list" -- a singly linked list of
@@ -8,8 +8,11 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+// Usage: nachos -d <debugflags> -rs <random seed #> -sched <policy>
+//		-quanta <ticks,ticks,...> -record <log> -replay <log>
+//		-s -b -j -x <nachos file> -c <consoleIn> <consoleOut>
+//		-mem <pages or size> -pagesize <bytes> -tlb <entries>
+//		-cpus <number of CPUs> -cpuslice <ticks> -hostcpus <threads>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
@@ -18,12 +21,30 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -sched chooses how to schedule threads: "priority" (the default),
+//	"fair" or "mlfq" (see threads/policy.h)
+//    -quanta sets the time slice, in ticks; for "mlfq", a list of them,
+//	one for each level from the top down
+//    -record logs each random timer delay, interrupt and context
+//	switch to a file; -replay runs with the timer going off as it
+//	did then, and stops at the first interrupt or switch that is
+//	different (see machine/replay.h)
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -b executes user programs a basic block at a time (faster)
+//    -j is like -b, but also compiles frequently run blocks (fastest)
 //    -x runs a user program
 //    -c tests the console
+//    -mem sets the size of physical memory, in pages or (with a K, M or
+//	G suffix) bytes
+//    -pagesize sets the page size, in bytes (a power of 2)
+//    -tlb sets the number of TLB entries
+//    -cpus sets the number of CPUs, each with its own registers and TLB
+//    -cpuslice sets how many ticks each CPU runs before the next one
+//    -hostcpus runs the user code of up to that many CPUs at once, on 
+//	separate host threads (use a long -cpuslice, e.g. 10000)
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
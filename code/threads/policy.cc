@@ -0,0 +1,685 @@
+// policy.cc
+//	Routines for the scheduling policies: strict priority,
+//	proportional share, and multi-level feedback queue.  See policy.h.
+//
+// 	These routines assume that interrupts are already disabled.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "policy.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// NewSchedulingPolicy
+// 	Make the scheduling policy called "name".
+//
+// Returns:
+//	The policy, or NULL if there isn't one of that name.
+//
+//	"name" is the name of the policy, as for -sched
+//	"quanta" is the time slice, as for -quanta, or NULL for the
+//		default (only MLFQPolicy takes a list, one for each level)
+//----------------------------------------------------------------------
+
+SchedulingPolicy *
+NewSchedulingPolicy(char *name, char *quanta)
+{
+    int timeSlice = (quanta != NULL ? atoi(quanta) : TimerTicks);
+
+    if (!strcmp(name, "priority"))
+	return new PriorityPolicy(timeSlice);
+    if (!strcmp(name, "fair"))
+	return new FairPolicy(timeSlice);
+    if (!strcmp(name, "mlfq"))
+	return new MLFQPolicy(quanta != NULL ? quanta : DefaultQuanta);
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// HighestBit
+// 	Return the number of the most significant bit set in "bits",
+//	which must not be zero, by binary search.
+//----------------------------------------------------------------------
+
+static int
+HighestBit(unsigned int bits)
+{
+    int bit = 0;
+
+    if (bits & 0xffff0000) { bits >>= 16; bit += 16; }
+    if (bits & 0xff00) { bits >>= 8; bit += 8; }
+    if (bits & 0xf0) { bits >>= 4; bit += 4; }
+    if (bits & 0xc) { bits >>= 2; bit += 2; }
+    if (bits & 0x2) bit += 1;
+    return bit;
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::PriorityPolicy
+// 	Initialize the ready queues to empty.
+//
+//	"timeSlice" is how long a thread runs before the timer goes off.
+//----------------------------------------------------------------------
+
+PriorityPolicy::PriorityPolicy(int timeSlice)
+{
+    ASSERT(NumPriorities <= 32);	// one bit each in readyLevels
+    ASSERT(timeSlice > 0);
+    readyLevels = 0;
+    quantum = timeSlice;
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::~PriorityPolicy
+// 	De-allocate the ready queues.  The threads on them belong to
+//	someone else.
+//----------------------------------------------------------------------
+
+PriorityPolicy::~PriorityPolicy()
+{
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::Insert
+// 	Put a thread on the end of the ready queue for its priority.
+//
+//	"thread" is the thread that is ready to run.
+//----------------------------------------------------------------------
+
+void
+PriorityPolicy::Insert(Thread *thread)
+{
+    int p = thread->getPriority();
+
+    readyList[p].Append(thread);
+    readyLevels |= (1 << p);
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::RemoveNext
+// 	Take the first thread off the queue of the highest priority with
+//	any threads in it.
+//
+// Returns:
+//	The thread, or NULL if no thread is ready.
+//----------------------------------------------------------------------
+
+Thread *
+PriorityPolicy::RemoveNext()
+{
+    Thread *thread;
+    int p;
+
+    if (IsEmpty())
+	return NULL;
+    p = HighestBit(readyLevels);
+    thread = readyList[p].Remove();
+    if (readyList[p].IsEmpty())
+	readyLevels &= ~(1 << p);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::Mapcar
+// 	Apply a function to each ready thread, in the order they will run.
+//
+//	"func" is the procedure to apply to each thread.
+//----------------------------------------------------------------------
+
+void
+PriorityPolicy::Mapcar(VoidFunctionPtr func)
+{
+    for (int p = NumPriorities - 1; p >= 0; p--)
+	readyList[p].Mapcar(func);
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::Preempts
+// 	A thread that becomes ready takes the CPU from any less
+//	important thread.
+//
+//	"thread" is the thread that is now ready.
+//	"running" is the thread that might have to give up its CPU.
+//----------------------------------------------------------------------
+
+bool
+PriorityPolicy::Preempts(Thread *thread, Thread *running)
+{
+    return (thread->getPriority() > running->getPriority());
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::Expired
+// 	The timer has gone off.  The running thread gives up the CPU to 
+//	another of the same priority, but never to a less important one
+//	(which it would if it just yielded).
+//
+//	"thread" is the thread that is running.
+//----------------------------------------------------------------------
+
+bool
+PriorityPolicy::Expired(Thread *thread)
+{
+    return (!IsEmpty() && HighestBit(readyLevels) >= thread->getPriority());
+}
+
+//----------------------------------------------------------------------
+// PriorityPolicy::PriorityChanged
+// 	Move a ready thread to the queue for its new priority.  It goes
+//	on the end, as if it had just become ready.
+//
+//	"thread" is the thread; it is on the queue for "oldPriority".
+//----------------------------------------------------------------------
+
+void
+PriorityPolicy::PriorityChanged(Thread *thread, int oldPriority)
+{
+    if (readyList[oldPriority].Remove(thread)) {
+	if (readyList[oldPriority].IsEmpty())
+	    readyLevels &= ~(1 << oldPriority);
+	Insert(thread);
+    }
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::FairPolicy
+// 	Initialize the heap of ready threads to empty, and work out the
+//	weight of each priority.
+//
+//	"timeSlice" is how long a thread runs before the timer goes off.
+//----------------------------------------------------------------------
+
+FairPolicy::FairPolicy(int timeSlice)
+{
+    ASSERT(timeSlice > 0);
+    quantum = timeSlice;
+    heapSize = 16;
+    heap = new FairEntry[heapSize];
+    numReady = 0;
+    nextOrder = 0;
+    minVruntime = 0;
+    weight[0] = NiceWeight;
+    for (int p = 1; p < NumPriorities; p++)
+	weight[p] = weight[p - 1] * 5 / 4;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::~FairPolicy
+// 	De-allocate the heap.  The threads on it belong to someone else.
+//----------------------------------------------------------------------
+
+FairPolicy::~FairPolicy()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::State
+// 	Return what we keep about a thread, starting it off with no
+//	virtual runtime the first time we see it.
+//
+//	"thread" is the thread.
+//----------------------------------------------------------------------
+
+FairThread *
+FairPolicy::State(Thread *thread)
+{
+    FairThread *state = (FairThread *) thread->policyData;
+
+    if (state == NULL) {
+	state = new FairThread;
+	state->vruntime = 0;
+	thread->policyData = (void *) state;
+    }
+    return state;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Forget
+// 	De-allocate what we keep about a thread that is going away.
+//
+//	"thread" is the thread.
+//----------------------------------------------------------------------
+
+void
+FairPolicy::Forget(Thread *thread)
+{
+    delete (FairThread *) thread->policyData;
+    thread->policyData = NULL;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Scale
+// 	Convert CPU time into virtual runtime: the more a thread weighs,
+//	the slower its virtual runtime goes.
+//
+//	"thread" is the thread that ran.
+//	"ticks" is how long it ran for.
+//----------------------------------------------------------------------
+
+int
+FairPolicy::Scale(Thread *thread, int ticks)
+{
+    return (int) ((double) ticks * NiceWeight
+				/ weight[thread->getPriority()]);
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Before
+// 	Return TRUE if the thread in "a" should run before the one in
+//	"b": it has had less virtual runtime, or the same, but became
+//	ready first.
+//----------------------------------------------------------------------
+
+bool
+FairPolicy::Before(FairEntry *a, FairEntry *b)
+{
+    if (a->vruntime != b->vruntime)
+	return (a->vruntime < b->vruntime);
+    return ((int) (a->order - b->order) < 0);
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Insert
+// 	Put a thread in the heap, and move it up to where it belongs.
+//
+//	A thread that has been blocked for a while (or is brand new)
+//	has fallen behind the others; it only gets to keep a little of
+//	that lead (SleeperCredit), so that it can't take over the CPU.
+//
+//	"thread" is the thread that is ready to run.
+//----------------------------------------------------------------------
+
+void
+FairPolicy::Insert(Thread *thread)
+{
+    FairThread *state = State(thread);
+    FairEntry entry;
+    int i, parent;
+
+    if (numReady == heapSize) {		// out of room; double it
+	FairEntry *bigger = new FairEntry[heapSize * 2];
+
+	for (i = 0; i < numReady; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	heapSize *= 2;
+    }
+    if (state->vruntime < minVruntime - SleeperCredit)
+	state->vruntime = minVruntime - SleeperCredit;
+    entry.thread = thread;
+    entry.vruntime = state->vruntime;
+    entry.order = nextOrder++;
+
+    for (i = numReady++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!Before(&entry, &heap[parent]))
+	    break;
+	heap[i] = heap[parent];
+    }
+    heap[i] = entry;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::RemoveNext
+// 	Take the thread with the least virtual runtime out of the heap.
+//	The last one in the heap takes its place, and is moved down to
+//	where it belongs.
+//
+// Returns:
+//	The thread, or NULL if no thread is ready.
+//----------------------------------------------------------------------
+
+Thread *
+FairPolicy::RemoveNext()
+{
+    Thread *thread;
+    FairEntry last;
+    int i, child;
+
+    if (IsEmpty())
+	return NULL;
+    thread = heap[0].thread;
+    if (heap[0].vruntime > minVruntime)
+	minVruntime = heap[0].vruntime;
+
+    last = heap[--numReady];
+    for (i = 0; (child = 2 * i + 1) < numReady; i = child) {
+	if (child + 1 < numReady && Before(&heap[child + 1], &heap[child]))
+	    child++;			// the earlier of the two children
+	if (!Before(&heap[child], &last))
+	    break;
+	heap[i] = heap[child];
+    }
+    heap[i] = last;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Mapcar
+// 	Apply a function to each ready thread, in no particular order.
+//	For debugging.
+//
+//	"func" is the procedure to apply to each thread.
+//----------------------------------------------------------------------
+
+void
+FairPolicy::Mapcar(VoidFunctionPtr func)
+{
+    for (int i = 0; i < numReady; i++)
+	(*func)((int) heap[i].thread);
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Preempts
+// 	A thread that becomes ready only takes the CPU if it is well
+//	behind the running thread -- counting the time that one has
+//	run so far, and hasn't been charged for yet.
+//
+//	"thread" is the thread that is now ready.
+//	"running" is the thread that might have to give up its CPU.
+//----------------------------------------------------------------------
+
+bool
+FairPolicy::Preempts(Thread *thread, Thread *running)
+{
+    int ran = stats->totalTicks - running->lastSwitch;
+    int current = State(running)->vruntime + Scale(running, max(ran, 0));
+
+    return (State(thread)->vruntime + WakeupGranularity < current);
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Expired
+// 	The timer has gone off.  The running thread gives up the CPU if
+//	the ready thread that has had the least virtual runtime is well
+//	behind it.
+//
+//	"thread" is the thread that is running, charged up to now.
+//----------------------------------------------------------------------
+
+bool
+FairPolicy::Expired(Thread *thread)
+{
+    return (!IsEmpty() && Preempts(heap[0].thread, thread));
+}
+
+//----------------------------------------------------------------------
+// FairPolicy::Charge
+// 	Add to a thread's virtual runtime, when it stops running.
+//
+//	"thread" is the thread that ran.
+//	"ticks" is how long it ran for.
+//----------------------------------------------------------------------
+
+void
+FairPolicy::Charge(Thread *thread, int ticks)
+{
+    State(thread)->vruntime += Scale(thread, ticks);
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::MLFQPolicy
+// 	Initialize the queues to empty, and read the quantum of each
+//	level.
+//
+//	"quanta" is a list of quanta, in ticks, separated by commas:
+//		the first is for the top level, and so on down.
+//----------------------------------------------------------------------
+
+MLFQPolicy::MLFQPolicy(const char *quanta)
+{
+    const char *q = quanta;
+
+    ASSERT(MaxLevels <= 32);		// one bit each in readyLevels
+    readyLevels = 0;
+    for (numLevels = 0; q != NULL; numLevels++) {
+	ASSERT(numLevels < MaxLevels);
+	quantum[numLevels] = atoi(q);
+	ASSERT(quantum[numLevels] > 0);
+	q = strchr(q, ',');
+	if (q != NULL)
+	    q++;
+    }
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::~MLFQPolicy
+// 	De-allocate the queues.  The threads on them belong to someone
+//	else.
+//----------------------------------------------------------------------
+
+MLFQPolicy::~MLFQPolicy()
+{
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::State
+// 	Return what we keep about a thread, starting it off at the top
+//	level the first time we see it.
+//
+//	"thread" is the thread.
+//----------------------------------------------------------------------
+
+MLFQThread *
+MLFQPolicy::State(Thread *thread)
+{
+    MLFQThread *state = (MLFQThread *) thread->policyData;
+
+    if (state == NULL) {
+	state = new MLFQThread;
+	state->level = 0;
+	state->levelTicks = 0;
+	state->queuedAt = 0;
+	thread->policyData = (void *) state;
+    }
+    return state;
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Forget
+// 	De-allocate what we keep about a thread that is going away.
+//
+//	"thread" is the thread.
+//----------------------------------------------------------------------
+
+void
+MLFQPolicy::Forget(Thread *thread)
+{
+    delete (MLFQThread *) thread->policyData;
+    thread->policyData = NULL;
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::TopLevel
+// 	Return the highest level (the lowest number) with any threads
+//	ready.  There must be one.
+//----------------------------------------------------------------------
+
+int
+MLFQPolicy::TopLevel()
+{
+    int l = 0;
+
+    ASSERT(!IsEmpty());
+    while (!(readyLevels & (1 << l)))
+	l++;
+    return l;
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Insert
+// 	Put a thread on the end of the queue for its level.
+//
+//	"thread" is the thread that is ready to run.
+//----------------------------------------------------------------------
+
+void
+MLFQPolicy::Insert(Thread *thread)
+{
+    MLFQThread *state = State(thread);
+
+    state->queuedAt = stats->totalTicks;
+    readyList[state->level].Append(thread);
+    readyLevels |= (1 << state->level);
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Age
+// 	Move any thread that has waited AgingTicks on its queue up a
+//	level, so that the threads on the lower levels don't starve
+//	while the ones above keep the CPU busy.  Each queue is in the 
+//	order its threads were put on it, so we only need to look at
+//	the front of each.
+//----------------------------------------------------------------------
+
+void
+MLFQPolicy::Age()
+{
+    Thread *thread;
+
+    for (int l = 1; l < numLevels; l++) {
+	while ((thread = readyList[l].First()) != NULL
+		&& stats->totalTicks - State(thread)->queuedAt >= AgingTicks) {
+	    DEBUG('t', "Moving waiting thread \"%s\" up to level %d\n",
+		  thread->getName(), l - 1);
+	    (void) readyList[l].Remove();
+	    if (readyList[l].IsEmpty())
+		readyLevels &= ~(1 << l);
+	    State(thread)->level = l - 1;
+	    State(thread)->levelTicks = 0;
+	    Insert(thread);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::RemoveNext
+// 	Move up any threads that have waited too long, then take the
+//	first thread off the highest queue with any threads in it.
+//
+// Returns:
+//	The thread, or NULL if no thread is ready.
+//----------------------------------------------------------------------
+
+Thread *
+MLFQPolicy::RemoveNext()
+{
+    Thread *thread;
+    int l;
+
+    if (IsEmpty())
+	return NULL;
+    Age();
+    l = TopLevel();
+    thread = readyList[l].Remove();
+    if (readyList[l].IsEmpty())
+	readyLevels &= ~(1 << l);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Mapcar
+// 	Apply a function to each ready thread, from the top level down.
+//
+//	"func" is the procedure to apply to each thread.
+//----------------------------------------------------------------------
+
+void
+MLFQPolicy::Mapcar(VoidFunctionPtr func)
+{
+    for (int l = 0; l < numLevels; l++)
+	readyList[l].Mapcar(func);
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Preempts
+// 	A thread that becomes ready takes the CPU from a thread on a
+//	lower level.
+//
+//	"thread" is the thread that is now ready.
+//	"running" is the thread that might have to give up its CPU.
+//----------------------------------------------------------------------
+
+bool
+MLFQPolicy::Preempts(Thread *thread, Thread *running)
+{
+    return (State(thread)->level < State(running)->level);
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Charge
+// 	Count the time a thread has run towards its quantum.
+//
+//	"thread" is the thread that ran.
+//	"ticks" is how long it ran for.
+//----------------------------------------------------------------------
+
+void
+MLFQPolicy::Charge(Thread *thread, int ticks)
+{
+    State(thread)->levelTicks += ticks;
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Quantum
+// 	Return how much of its quantum a thread has left, at its level.
+//
+//	"thread" is the thread about to run.
+//----------------------------------------------------------------------
+
+int
+MLFQPolicy::Quantum(Thread *thread)
+{
+    MLFQThread *state = State(thread);
+    int left = quantum[state->level] - state->levelTicks;
+
+    return (left > 0 ? left : 1);
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Expired
+// 	The timer has gone off.  If the running thread has used up its
+//	quantum, move it down a level, and have it give up the CPU.
+//	Otherwise, it runs on -- even if there is now a thread ready on
+//	a higher level; a thread woken up by an interrupt handler has
+//	already taken the CPU (see Scheduler::ReadyToRun), and for any 
+//	other, it waits at most a quantum.
+//
+//	"thread" is the thread that is running, charged up to now.
+//----------------------------------------------------------------------
+
+bool
+MLFQPolicy::Expired(Thread *thread)
+{
+    MLFQThread *state = State(thread);
+
+    if (state->levelTicks < quantum[state->level])
+	return FALSE;
+    if (state->level < numLevels - 1)
+	state->level++;
+    state->levelTicks = 0;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// MLFQPolicy::Blocked
+// 	A thread is about to wait, before using up its quantum: move it
+//	up a level.
+//
+//	"thread" is the thread that is about to wait, charged up to now.
+//----------------------------------------------------------------------
+
+void
+MLFQPolicy::Blocked(Thread *thread)
+{
+    MLFQThread *state = State(thread);
+
+    if (state->level > 0)
+	state->level--;
+    state->levelTicks = 0;
+}
@@ -0,0 +1,230 @@
+// policy.h
+//	Data structures for scheduling policies: the part of the scheduler
+//	that decides which ready thread to run next.
+//
+//	The Scheduler keeps track of the running threads, switches between
+//	them, and charges each for the time it runs.  Which ready thread
+//	goes next is up to its SchedulingPolicy, which holds the ready
+//	threads in whatever order suits it.  There are three policies:
+//
+//	PriorityPolicy -- strict priority: always run the most important
+//		ready thread, and among those, the one that has been ready
+//		longest.  A thread that becomes ready takes the CPU from a
+//		less important one.
+//
+//	FairPolicy -- proportional share, along the lines of the Linux
+//		"completely fair scheduler".  Each thread's CPU time is
+//		scaled by a weight that grows with its priority, into its
+//		"virtual runtime", and the ready thread that has had the
+//		least of it runs next.  So every thread gets a share of
+//		the CPU in proportion to its weight; none starves.
+//
+//	MLFQPolicy -- a multi-level feedback queue.  Threads move between
+//		a few queues, according to how they have behaved lately: a
+//		thread that uses up its quantum moves down to a queue with
+//		a longer quantum, and one that blocks before it does moves
+//		up.  So threads that only want the CPU for a moment (those
+//		waiting for the user, say) run ahead of the CPU hogs,
+//		whatever their static priority; and threads that have
+//		waited a long time are moved up, so that none starves.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef POLICY_H
+#define POLICY_H
+
+#include "copyright.h"
+#include "ilist.h"
+#include "thread.h"
+
+// The following class defines the interface every scheduling policy
+// provides to the Scheduler.  All of them are called with interrupts
+// disabled.
+//
+// What a policy keeps about each thread is its own business: it hangs
+// it off the thread's "policyData", allocating it the first time it
+// sees the thread, and de-allocating it in Forget.
+
+class SchedulingPolicy {
+  public:
+    virtual ~SchedulingPolicy() {}
+
+    virtual char *Name() = 0;		// for printing
+    virtual void Insert(Thread *thread) = 0;
+					// Add "thread" to the ready threads
+    virtual Thread *RemoveNext() = 0;	// Take the thread to run next off
+					// the ready list; NULL if none
+    virtual bool IsEmpty() = 0;		// Are any threads ready?
+    virtual void Mapcar(VoidFunctionPtr func) = 0;
+					// Apply "func" to each ready thread
+    virtual bool Preempts(Thread *thread, Thread *running) = 0;
+					// Should "thread", just made ready,
+					// take the CPU from "running"?
+    virtual void Charge(Thread *thread, int ticks) {}
+					// "thread" has just run for "ticks"
+    virtual int Quantum(Thread *thread) = 0;
+					// How long "thread" may run before
+					// the timer goes off
+    virtual bool Expired(Thread *thread) { return TRUE; }
+					// The timer has gone off while
+					// "thread" was running: should it
+					// give up the CPU?
+    virtual void Blocked(Thread *thread) {}
+					// "thread" is about to wait (in
+					// Semaphore::P)
+    virtual void PriorityChanged(Thread *thread, int oldPriority) {}
+					// "thread", which is ready, has
+					// been lent a different priority
+    virtual void Forget(Thread *thread) {}
+					// "thread" is about to be
+					// de-allocated
+};
+
+// Returns a new policy, given its name ("priority", "fair" or "mlfq"),
+// or NULL if there is no policy of that name.  "quanta" is its time
+// slice, in ticks (for MLFQPolicy, a list of them), or NULL for the
+// default.
+extern SchedulingPolicy *NewSchedulingPolicy(char *name, char *quanta);
+
+// Strict priority: a FIFO queue for each priority, and a bitmap of
+// which queues have anything in them, so that putting a thread on
+// the ready list, and finding the next one to run, take the same
+// (short) time however many threads are ready.
+
+class PriorityPolicy : public SchedulingPolicy {
+  public:
+    PriorityPolicy(int timeSlice);	// "timeSlice" is the quantum of
+					// every thread
+    ~PriorityPolicy();
+
+    char *Name() { return "priority"; }
+    void Insert(Thread *thread);
+    Thread *RemoveNext();
+    bool IsEmpty() { return (readyLevels == 0); }
+    void Mapcar(VoidFunctionPtr func);
+    bool Preempts(Thread *thread, Thread *running);
+    int Quantum(Thread *thread) { return quantum; }
+    bool Expired(Thread *thread);
+    void PriorityChanged(Thread *thread, int oldPriority);
+
+  private:
+    IList<Thread> readyList[NumPriorities]; // queues of threads that are
+				// ready to run, but not running: one
+				// for each priority
+    unsigned int readyLevels;	// bit p is set if the queue for
+				// priority p is not empty
+    int quantum;		// how long a thread runs before another
+				// of the same priority gets a turn
+};
+
+// Proportional share.  The ready threads are kept in a binary heap,
+// ordered by virtual runtime (and, among equals, the order they became
+// ready in), so the next one to run is always at the top.
+
+#define NiceWeight	1024	// the weight of a thread of priority 0;
+				// each priority above that has 1.25 times
+				// the weight of the one below
+#define SleeperCredit	100	// how far behind the others a thread can
+				// fall while blocked, in virtual runtime
+#define WakeupGranularity 100	// how far behind the running thread a
+				// ready thread must be to preempt it
+
+class FairThread {
+  public:
+    int vruntime;		// its running time, scaled down by its
+				// weight
+};
+
+class FairEntry {
+  public:
+    Thread *thread;		// a ready thread
+    int vruntime;		// its virtual runtime, when it became ready
+    unsigned int order;		// when it became ready, to break ties
+};
+
+class FairPolicy : public SchedulingPolicy {
+  public:
+    FairPolicy(int timeSlice);		// "timeSlice" is how long a thread
+					// runs before it is checked on
+    ~FairPolicy();
+
+    char *Name() { return "fair"; }
+    void Insert(Thread *thread);
+    Thread *RemoveNext();
+    bool IsEmpty() { return (numReady == 0); }
+    void Mapcar(VoidFunctionPtr func);
+    bool Preempts(Thread *thread, Thread *running);
+    void Charge(Thread *thread, int ticks);
+    int Quantum(Thread *thread) { return quantum; }
+    bool Expired(Thread *thread);
+    void Forget(Thread *thread);
+
+  private:
+    FairEntry *heap;		// heap[0] runs next; heap[i] runs no later
+				// than heap[2i+1] and heap[2i+2]
+    int numReady;		// how many threads are in the heap
+    int heapSize;		// how many it has room for
+    unsigned int nextOrder;	// stamped on each thread inserted
+    int minVruntime;		// the least virtual runtime of any thread
+				// run so far; never goes backwards
+    int weight[NumPriorities];	// the weight of each priority
+    int quantum;		// how often to see whether the running
+				// thread has had its share
+
+    FairThread *State(Thread *thread);	// what we keep about "thread"
+    int Scale(Thread *thread, int ticks); // "ticks" of CPU time, in
+				// virtual runtime for "thread"
+    bool Before(FairEntry *a, FairEntry *b); // Should "a" run before "b"?
+};
+
+// Multi-level feedback queue.  Level 0 is the top; each level has a
+// FIFO queue, and a quantum, set by "-quanta" as a list of ticks, one
+// for each level, e.g. "100,200,400,800".  A thread's static priority
+// plays no part.
+
+#define MaxLevels	NumPriorities	// one bit each in readyLevels
+#define DefaultQuanta	"100,200,400,800"
+#define AgingTicks	5000	// how long a thread waits on a queue before
+				// it is moved up a level
+
+class MLFQThread {
+  public:
+    int level;			// its queue (0 is the top)
+    int levelTicks;		// how long it has run at that level
+    int queuedAt;		// when it was last put on a queue
+};
+
+class MLFQPolicy : public SchedulingPolicy {
+  public:
+    MLFQPolicy(const char *quanta);	// "quanta" as for -quanta
+    ~MLFQPolicy();
+
+    char *Name() { return "mlfq"; }
+    void Insert(Thread *thread);
+    Thread *RemoveNext();
+    bool IsEmpty() { return (readyLevels == 0); }
+    void Mapcar(VoidFunctionPtr func);
+    bool Preempts(Thread *thread, Thread *running);
+    void Charge(Thread *thread, int ticks);
+    int Quantum(Thread *thread);
+    bool Expired(Thread *thread);
+    void Blocked(Thread *thread);
+    void Forget(Thread *thread);
+
+  private:
+    IList<Thread> readyList[MaxLevels];	// the queue for each level
+    unsigned int readyLevels;	// bit l is set if the queue for level l
+				// is not empty
+    int quantum[MaxLevels];	// how long a thread may run at each level
+				// before it moves down
+    int numLevels;		// how many levels there are
+
+    MLFQThread *State(Thread *thread);	// what we keep about "thread"
+    int TopLevel();		// the highest level with a thread ready
+    void Age();			// move up threads that have waited
+				// AgingTicks
+};
+
+#endif // POLICY_H
@@ -11,8 +11,24 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	The order threads run in is up to a SchedulingPolicy: by default
+//	strict priority, but see policy.h for the others.  The scheduler
+//	does the rest, including keeping track of how long each thread
+//	runs, and how long it waits to run: a thread is charged for the
+//	time since it last started or stopped running (Thread::lastSwitch)
+//	whenever it does either.  Thread::Print shows the lot.
+//
+//	When the simulated machine has several CPUs, each runs a thread
+//	of its own (cpuThread[]), but we still only run one of them at a 
+//	time: the current CPU's thread is currentThread.  Every so often
+//	(see Interrupt::NextSlice), we switch to the thread of the next 
+//	CPU, leaving the others where they were.  So there is still 
+//	mutual exclusion with interrupts disabled.
+//
+//	The user registers and page table of a user program are saved
+//	lazily: a thread switched away from leaves them loaded in its CPU,
+//	and they are only saved once another user program needs that CPU
+//	(see Scheduler::RestoreUserState).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,30 +38,120 @@
 #include "scheduler.h"
 #include "system.h"
 
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// RescheduleHandler
+// 	Handler for the IPI one CPU sends another, when a thread that 
+//	should be running instead of the one there becomes ready.  As 
+//	with the timer, switch threads once the handler returns.
+//
+//	"dummy" is because every interrupt handler takes one argument.
+//----------------------------------------------------------------------
+
+static void
+RescheduleHandler(int dummy)
+{
+    interrupt->YieldOnReturn();
+}
+#endif
+
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
 // 	Initialize the list of ready but not running threads to empty.
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(SchedulingPolicy *readyPolicy)
 { 
-    readyList = new List; 
+    policy = readyPolicy;
+    numSwitches = 0;
+    switchStart = 0;
+    switchStartTicks = -1;
+#ifdef USER_PROGRAM
+    for (int cpu = 0; cpu < MaxCPUs; cpu++) {
+	registersOwner[cpu] = NULL;
+	loadedSpace[cpu] = NULL;
+    }
+#endif
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
-// 	De-allocate the list of ready threads.
+// 	De-allocate the list of ready threads.  The threads on it belong
+//	to someone else.
 //----------------------------------------------------------------------
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    delete policy;
 } 
 
+//----------------------------------------------------------------------
+// Scheduler::StartRunning
+// 	A thread is about to run: count the context switch, charge it
+//	for the time it spent waiting on the ready list (and count that
+//	in the latency histograms), and set the timer to go off when its
+//	quantum is up.  If it gives up the CPU before then, the next
+//	thread to run sets the timer again, so there is no interrupt at
+//	all.  (With several CPUs, the clock is wound back at the start of
+//	each CPU's turn, so the time may come out negative; we don't
+//	count it.)
+//
+//	"thread" is the thread about to run.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StartRunning(Thread *thread)
+{
+    int waited = stats->totalTicks - thread->lastSwitch;
+
+    if (waited >= 0) {
+	thread->waitTicks += waited;
+	if (waited > thread->maxWait)
+	    thread->maxWait = waited;
+	thread->readyLatency.Add(waited);
+	stats->readyLatency.Add(waited);
+    }
+    thread->lastSwitch = stats->totalTicks;
+    thread->lastUserTicks = stats->userTicks;
+    stats->numContextSwitches++;
+    if (timer != NULL)
+	timer->SetAlarm(policy->Quantum(thread));
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StopRunning
+// 	A thread has stopped running, for now: charge it, and tell the
+//	policy, how long it ran.
+//
+//	"thread" is the thread that was running.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StopRunning(Thread *thread)
+{
+    int ran = stats->totalTicks - thread->lastSwitch;
+    int user = stats->userTicks - thread->lastUserTicks;
+
+    if (ran > 0) {
+	thread->cpuTicks += ran;
+	if (user > 0)
+	    thread->userTicks += (user < ran) ? user : ran;
+	policy->Charge(thread, ran);
+    }
+    thread->lastSwitch = stats->totalTicks;
+    thread->lastUserTicks = stats->userTicks;
+}
+
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
 //	Put it on the ready list, for later scheduling onto the CPU.
+//	If it is the current thread, giving up the CPU, charge it for
+//	its time first, since the policy may need to know.
+//
+//	If an interrupt handler wakes up a thread that should run instead
+//	of the current one, switch to it once the handler returns, as 
+//	with the timer.
 //
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
@@ -55,14 +161,45 @@ Scheduler::ReadyToRun (Thread *thread)
 {
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    if (thread == currentThread && thread->getStatus() == RUNNING)
+	StopRunning(thread);
+    else {
+	if (thread->getStatus() == BLOCKED	// how long it slept, since
+		&& stats->totalTicks > thread->lastSwitch) // it stopped
+	    thread->blockedTicks += stats->totalTicks - thread->lastSwitch;
+	thread->lastSwitch = stats->totalTicks;	// starts waiting now
+    }
     thread->setStatus(READY);
-    readyList->SortedInsert((void *)thread, -thread->getPriority());
+    policy->Insert(thread);
+    if (interrupt->InHandler() && currentThread->getStatus() == RUNNING
+			&& policy->Preempts(thread, currentThread)) {
+	interrupt->YieldOnReturn();
+	return;
+    }
+#ifdef USER_PROGRAM
+    if (machine != NULL && machine->NumCPUs() > 1) {
+	// If every other CPU is busy, tell the first one whose thread
+	// the policy says "thread" should preempt to give up its CPU.
+	int cpu;
+
+	for (cpu = 0; cpu < machine->NumCPUs(); cpu++)
+	    if (cpu != machine->CurrentCPU() && cpuThread[cpu] == NULL)
+		return;			// it will pick up the thread soon
+	for (cpu = 0; cpu < machine->NumCPUs(); cpu++) {
+	    if (cpu != machine->CurrentCPU()
+			&& policy->Preempts(thread, cpuThread[cpu])) {
+		interrupt->SendIPI(cpu, RescheduleHandler, 0);
+		return;
+	    }
+	}
+    }
+#endif
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
-// 	Return the next thread to be scheduled onto the CPU.
-//	If there are no ready threads, return NULL.
+// 	Return the next thread to be scheduled onto the CPU, as chosen
+//	by the policy.  If there are no ready threads, return NULL.
 // Side effect:
 //	Thread is removed from the ready list.
 //----------------------------------------------------------------------
@@ -70,7 +207,77 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->SortedRemove(NULL);
+    return policy->RemoveNext();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ShouldPreempt
+// 	Return TRUE if a thread that has just been put on the ready list
+//	should take the CPU from the current thread right away, rather
+//	than waiting its turn.  Up to the policy.
+//
+//	"thread" is the thread that is now ready.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::ShouldPreempt(Thread *thread)
+{
+    return policy->Preempts(thread, currentThread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::QuantumExpired
+// 	Called by the timer interrupt handler.  Return TRUE if the current
+//	thread should give up the CPU, once the handler returns.  (With
+//	several CPUs, the handler runs on the CPU whose timer went off,
+//	so the current thread is the one whose quantum is up.)  Up to
+//	the policy, which needs the thread charged for its time so far.
+//
+//	Either way, set the timer for the current thread's next quantum,
+//	in case there is no other thread to run; if there is, the timer
+//	is set again for that one.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::QuantumExpired()
+{
+    bool expired;
+
+    StopRunning(currentThread);
+    expired = policy->Expired(currentThread);
+    timer->SetAlarm(policy->Quantum(currentThread));
+    return expired;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Blocked
+// 	Called when a thread is about to wait for something, so the
+//	policy can take note.
+//
+//	"thread" is the thread about to wait (the current thread).
+//----------------------------------------------------------------------
+
+void
+Scheduler::Blocked(Thread *thread)
+{
+    StopRunning(thread);
+    policy->Blocked(thread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PriorityChanged
+// 	Called when a thread's priority changes because of priority
+//	inheritance (see Lock::Acquire).  If it is on the ready list,
+//	the policy may have to move it.
+//
+//	"thread" is the thread; "oldPriority" is what it was.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PriorityChanged(Thread *thread, int oldPriority)
+{
+    if (thread->getStatus() == READY)
+	policy->PriorityChanged(thread, oldPriority);
 }
 
 //----------------------------------------------------------------------
@@ -92,18 +299,25 @@ Scheduler::Run (Thread *nextThread)
 {
     Thread *oldThread = currentThread;
     
-#ifdef USER_PROGRAM			// ignore until running user programs 
-    if (currentThread->space != NULL) {	// if this thread is a user program,
-        currentThread->SaveUserState(); // save the user's CPU registers
-	currentThread->space->SaveState();
-    }
-#endif
-    
+    StartSwitch();			    // time it, until FinishSwitch
+    if (replayLog != NULL)		    // log it, or check it was logged
+	replayLog->Switched(nextThread->getThreadId());
+    if (oldThread->getStatus() == READY)    // preempted, or yielded
+	oldThread->involuntarySwitches++;
+    else				    // waiting for something
+	oldThread->voluntarySwitches++;
+
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
+    StopRunning(oldThread);		    // charge each for its time
+    StartRunning(nextThread);
 
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+#ifdef USER_PROGRAM
+    if (machine != NULL)
+	cpuThread[machine->CurrentCPU()] = nextThread;
+#endif
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -117,21 +331,64 @@ Scheduler::Run (Thread *nextThread)
     
     DEBUG('t', "Now in thread \"%s\"\n", currentThread->getName());
 
-    // If the old thread gave up the processor because it was finishing,
-    // we need to delete its carcass.  Note we cannot delete the thread
-    // before now (for example, in Thread::Finish()), because up to this
-    // point, we were still running on the old thread's stack!
+    FinishSwitch();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StartSwitch
+// 	A context switch is about to start; note the time, so that
+//	FinishSwitch can charge the statistics for it.  Reading the host
+//	clock costs a fair fraction of a switch, so we only time one
+//	switch in every SwitchSampling.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StartSwitch()
+{
+    switchStartTicks = stats->totalTicks;
+    if (++numSwitches % SwitchSampling == 0)
+	switchStart = HostTime();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::FinishSwitch
+// 	The second half of a context switch, done by the thread switched
+//	to, once it is back on its own stack: de-allocate the thread that
+//	gave up the processor because it was finishing, if it did (and
+//	have the policy forget about it); give
+//	the current thread back its user state, if it has any; and charge
+//	the switch to the statistics, if it is being timed.
+//
+//	Note we cannot delete the finished thread before now (for example,
+//	in Thread::Finish()), because up to this point, we were still
+//	running on its stack!
+//----------------------------------------------------------------------
+
+void
+Scheduler::FinishSwitch()
+{
     if (threadToBeDestroyed != NULL) {
+#ifdef USER_PROGRAM
+	for (int cpu = 0; cpu < MaxCPUs; cpu++)	// its registers are
+	    if (registersOwner[cpu] == threadToBeDestroyed) // no use to 
+		registersOwner[cpu] = NULL;		// anyone now
+#endif
+	policy->Forget(threadToBeDestroyed);
         delete threadToBeDestroyed;
 	threadToBeDestroyed = NULL;
     }
-    
 #ifdef USER_PROGRAM
-    if (currentThread->space != NULL) {		// if there is an address space
-        currentThread->RestoreUserState();     // to restore, do it.
-	currentThread->space->RestoreState();
-    }
+    RestoreUserState();
 #endif
+    if (switchStartTicks >= 0) {
+	stats->switchTicks += stats->totalTicks - switchStartTicks;
+	switchStartTicks = -1;
+    }
+    if (switchStart != 0) {
+	stats->switchHostTime += HostTime() - switchStart;
+	stats->numSwitchesTimed++;
+	switchStart = 0;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -142,6 +399,200 @@ Scheduler::Run (Thread *nextThread)
 void
 Scheduler::Print()
 {
-    printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    printf("Ready list contents (%s):\n", policy->Name());
+    policy->Mapcar((VoidFunctionPtr) ThreadPrint);
 }
+
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// Scheduler::IdleCPU
+// 	Called by a thread going to sleep when there is nothing else 
+//	ready to run.  If another CPU is still busy, leave this one idle
+//	and go on with the thread there, for the rest of this CPU's turn.
+//	Returns FALSE (and doesn't switch) if all the other CPUs are 
+//	idle as well.  Otherwise, returns once the thread has been
+//	woken up, and run again, maybe on some other CPU.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::IdleCPU()
+{
+    Thread *oldThread = currentThread;
+    int cpu, next = -1;
+
+    ASSERT(interrupt->getLevel() == IntOff);
+    if (machine == NULL)
+	return FALSE;
+    for (cpu = 0; cpu < machine->NumCPUs(); cpu++)
+	if (cpuThread[cpu] != NULL && cpu != machine->CurrentCPU()) {
+	    next = cpu;
+	    break;
+	}
+    if (next < 0)
+	return FALSE;
+
+    DEBUG('t', "CPU %d idle, going on with CPU %d\n", 
+					machine->CurrentCPU(), next);
+    cpuThread[machine->CurrentCPU()] = NULL;
+    oldThread->voluntarySwitches++;
+    oldThread->CheckOverflow();
+    StopRunning(oldThread);
+    machine->SwitchCPU(next);
+    currentThread = cpuThread[next];
+    if (replayLog != NULL)
+	replayLog->Switched(currentThread->getThreadId());
+    currentThread->lastUserTicks = stats->userTicks; // the user code run
+					// meanwhile was on other CPUs
+
+    SWITCH(oldThread, currentThread);
+
+    // We've been woken up, and Scheduler::Run has switched back to us, 
+    // but it is our own stack, so we have to finish its job.
+    FinishSwitch();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextCPU
+// 	Called at the end of the current CPU's turn.  Go on with the
+//	next CPU that has something to do -- a thread of its own, or
+//	one on the ready list it could pick up.  The CPUs take their 
+//	turns in order; once the last one is done, a new round starts.
+//----------------------------------------------------------------------
+
+void
+Scheduler::NextCPU()
+{
+    int cpu, next = -1;
+    bool sameRound = TRUE;
+    bool work = !policy->IsEmpty();
+
+    ASSERT(interrupt->getLevel() == IntOff);
+    for (cpu = machine->CurrentCPU() + 1; cpu < machine->NumCPUs(); cpu++)
+	if (cpuThread[cpu] != NULL || work) {
+	    next = cpu;
+	    break;
+	}
+    if (next < 0) {			// start over at the first CPU
+	sameRound = FALSE;
+	for (cpu = 0; cpu <= machine->CurrentCPU(); cpu++)
+	    if (cpuThread[cpu] != NULL || work) {
+		next = cpu;
+		break;
+	    }
+    }
+    ASSERT(next >= 0);			// we're running, at least
+
+    interrupt->NextSlice(sameRound);
+    if (next != machine->CurrentCPU())
+	SwitchToCPU(next);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SwitchToCPU
+// 	Leave the current CPU's thread where it is, and go on with the
+//	thread on "cpu".  If that CPU is idle, give it a thread from the
+//	ready list first.  The state of the thread we leave stays in 
+//	its CPU, so there is no need to save it.
+//
+//	"cpu" is the CPU to run next.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchToCPU(int cpu)
+{
+    Thread *oldThread = currentThread;
+    Thread *nextThread = cpuThread[cpu];
+    
+    if (nextThread == NULL) {
+	nextThread = FindNextToRun();
+	ASSERT(nextThread != NULL);
+	StartSwitch();
+	StartRunning(nextThread);
+	nextThread->setStatus(RUNNING);
+	cpuThread[cpu] = nextThread;
+    }
+    DEBUG('t', "Switching from CPU %d to CPU %d, thread \"%s\"\n",
+	  machine->CurrentCPU(), cpu, nextThread->getName());
+
+    // Each thread is only charged for the user code run on its own CPU.
+    if (stats->userTicks > oldThread->lastUserTicks)
+	oldThread->userTicks += stats->userTicks - oldThread->lastUserTicks;
+    nextThread->lastUserTicks = stats->userTicks;
+
+    oldThread->CheckOverflow();
+    machine->SwitchCPU(cpu);
+    currentThread = nextThread;
+
+    SWITCH(oldThread, nextThread);
+
+    DEBUG('t', "Now in thread \"%s\"\n", currentThread->getName());
+    FinishSwitch();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RestoreUserState
+// 	If the current thread is running a user program, make sure the
+//	current CPU has its user registers and page table loaded.  Called
+//	after each context switch, and by a thread about to start running
+//	a user program.
+//
+//	A thread switched away from leaves its registers in its CPU, and
+//	its page table loaded; nothing is saved until another user program
+//	needs them.  So a switch to a kernel thread and back again copies
+//	no registers, and a switch between threads sharing an address
+//	space leaves the page table (and soft TLB) as it is.  If the
+//	thread last ran on some other CPU, its registers may still be
+//	there, and we fetch them from there.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RestoreUserState()
+{
+    AddrSpace *space = currentThread->space;
+    int cpu, here;
+    Thread *owner;
+
+    if (space == NULL)			// a kernel thread; it doesn't use
+	return;				// the user registers
+    here = machine->CurrentCPU();
+    owner = registersOwner[here];
+    if (owner != currentThread) {
+	if (owner != NULL) {		// someone else's are still here
+	    owner->SaveUserState(here);
+	    stats->numRegisterCopies++;
+	}
+	for (cpu = 0; cpu < machine->NumCPUs(); cpu++)
+	    if (registersOwner[cpu] == currentThread) {	// ours are there
+		currentThread->SaveUserState(cpu);
+		registersOwner[cpu] = NULL;
+		stats->numRegisterCopies++;
+	    }
+	currentThread->RestoreUserState();
+	stats->numRegisterCopies++;
+	registersOwner[here] = currentThread;
+    }
+    if (loadedSpace[here] != space) {
+	if (loadedSpace[here] != NULL)
+	    loadedSpace[here]->SaveState();
+	space->RestoreState();
+	loadedSpace[here] = space;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ForgetSpace
+// 	An address space is being de-allocated; make sure no CPU is taken
+//	to have it loaded, in case another is allocated in its place.
+//
+//	"space" is the address space.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ForgetSpace(AddrSpace *space)
+{
+    for (int cpu = 0; cpu < MaxCPUs; cpu++)
+	if (loadedSpace[cpu] == space)
+	    loadedSpace[cpu] = NULL;
+}
+#endif
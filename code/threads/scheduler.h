@@ -10,27 +10,76 @@
 #define SCHEDULER_H
 
 #include "copyright.h"
-#include "list.h"
 #include "thread.h"
+#include "policy.h"
+#ifdef USER_PROGRAM
+#include "interrupt.h"
+#endif
+
+// How often to read the host clock, to time a context switch: one in 
+// every this many.
+#define SwitchSampling	16
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+// Which of those runs next is up to a SchedulingPolicy (see policy.h).
 
 class Scheduler {
   public:
-    Scheduler();			// Initialize list of ready threads 
+    Scheduler(SchedulingPolicy *readyPolicy);
+					// Initialize list of ready threads,
+					// kept by "readyPolicy"
     ~Scheduler();			// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
     Thread* FindNextToRun();		// Dequeue first thread on the ready 
 					// list, if any, and return thread.
+    bool ShouldPreempt(Thread *thread);	// Should "thread", just made ready,
+					// run instead of the current thread?
+    bool QuantumExpired();		// Should the current thread give up
+					// the CPU, now the timer has gone off?
+    void Blocked(Thread *thread);	// "thread" is about to wait
+    void PriorityChanged(Thread *thread, int oldPriority);
+					// "thread" has been lent a different
+					// priority
     void Run(Thread* nextThread);	// Cause nextThread to start running
+    void FinishSwitch();		// Called by the thread switched to,
+					// to finish the job
     void Print();			// Print contents of ready list
+
+#ifdef USER_PROGRAM
+    bool IdleCPU();			// Leave this CPU idle, and go on
+					// with another one, if any is busy
+    void NextCPU();			// This CPU's turn is over; go on
+					// with the next one
+    void RestoreUserState();		// Load the current thread's user
+					// registers and page table, if they
+					// aren't loaded already
+    void ForgetSpace(AddrSpace *space);	// "space" is being de-allocated
+#endif
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
+    SchedulingPolicy *policy;	// the threads that are ready to run,
 				// but not running
+
+    void StartRunning(Thread *thread);	// Charge threads for the time 
+    void StopRunning(Thread *thread);	// since they last started or
+					// stopped running
+    void StartSwitch();			// Note when a context switch began
+    int numSwitches;			// how many have begun
+    int switchStartTicks;		// when the one in progress began, or
+					// -1 if none is
+    double switchStart;			// the same, in host seconds; or 0 if
+					// it isn't being timed
+#ifdef USER_PROGRAM
+    void SwitchToCPU(int cpu);	// Go on with the thread on "cpu"
+
+    Thread *registersOwner[MaxCPUs];	// the thread whose user registers
+					// each CPU's register file holds
+    AddrSpace *loadedSpace[MaxCPUs];	// the address space each CPU's
+					// page table register points to
+#endif
 };
 
 #endif // SCHEDULER_H
@@ -1,8 +1,7 @@
 // synch.cc 
-//	Routines for synchronizing threads.  Three kinds of
-//	synchronization routines are defined here: semaphores, locks 
-//   	and condition variables (the implementation of the last two
-//	are left to the reader).
+//	Routines for synchronizing threads.  Four kinds of
+//	synchronization routines are defined here: semaphores, locks,
+//   	condition variables, and reader-writer locks.
 //
 // Any implementation of a synchronization routine needs some
 // primitive atomic operation.  We assume Nachos is running on
@@ -37,7 +36,6 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 {
     name = debugName;
     value = initialValue;
-    queue = new List;
 }
 
 //----------------------------------------------------------------------
@@ -48,65 +46,589 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 
 Semaphore::~Semaphore()
 {
-    delete queue;
 }
 
 //----------------------------------------------------------------------
 // Semaphore::P
-// 	Wait until semaphore value > 0, then decrement.  Checking the
-//	value and decrementing must be done atomically, so we
+// 	Wait until semaphore value >= n, then subtract n.  Checking the
+//	value and subtracting must be done atomically, so we
 //	need to disable interrupts before checking the value.
 //
+//	If anyone is already waiting, we wait behind them, even if the
+//	value would do for us; otherwise a stream of small requests
+//	could keep a big one waiting forever.  Whoever wakes us up has
+//	already subtracted n for us (see V()).
+//
 //	Note that Thread::Sleep assumes that interrupts are disabled
 //	when it is called.
+//
+//	"n" is how much to take; P() takes 1.
 //----------------------------------------------------------------------
 
 void
-Semaphore::P()
+Semaphore::P(int n)
 {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     
-    while (value == 0) { 			// semaphore not available
-	queue->Append((void *)currentThread);	// so go to sleep
+    ASSERT(n > 0);
+    if (value >= n && queue.IsEmpty())	// semaphore available, 
+	value -= n;			// consume its value
+    else {				// wait our turn
+	currentThread->wanted = n;
+	queue.Append(currentThread);	// so go to sleep
+	scheduler->Blocked(currentThread);
 	currentThread->Sleep();
     } 
-    value--; 					// semaphore available, 
-						// consume its value
     
     (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
 }
 
 //----------------------------------------------------------------------
 // Semaphore::V
-// 	Increment semaphore value, waking up a waiter if necessary.
-//	As with P(), this operation must be atomic, so we need to disable
-//	interrupts.  Scheduler::ReadyToRun() assumes that threads
-//	are disabled when it is called.
+// 	Add n to the semaphore value, waking up waiters if necessary --
+//	as many, from the front of the queue, as the value will satisfy.
+//	Each one's share is subtracted as it is woken, so that no one
+//	can take it first.  As with P(), this operation must be atomic,
+//	so we need to disable interrupts.  Scheduler::ReadyToRun()
+//	assumes that threads are disabled when it is called.
+//
+//	"n" is how much to add; V() adds 1.
 //----------------------------------------------------------------------
 
 void
-Semaphore::V()
+Semaphore::V(int n)
 {
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
-    if (thread != NULL)	   // make thread ready, consuming the V immediately
+    ASSERT(n > 0);
+    value += n;
+    while ((thread = queue.First()) != NULL && thread->wanted <= value) {
+	value -= thread->wanted;	// hand it its share
+	(void) queue.Remove();
 	scheduler->ReadyToRun(thread);
-    value++;
+    }
     (void) interrupt->SetLevel(oldLevel);
 }
 
-// Dummy functions -- so we can compile our later assignments 
-// Note -- without a correct implementation of Condition::Wait(), 
-// the test case in the network assignment won't work!
-Lock::Lock(char* debugName) {}
-Lock::~Lock() {}
-void Lock::Acquire() {}
-void Lock::Release() {}
+//----------------------------------------------------------------------
+// LockStats::LockStats
+// 	Initialize the statistics for the locks of a name.
+//
+//	"lockName" is the name.
+//----------------------------------------------------------------------
+
+LockStats::LockStats(char *lockName)
+{
+    name = lockName;
+    acquires = contended = 0;
+    waitTicks = maxWait = holdTicks = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// LockStats::Waited
+// 	Count a thread's wait for a lock.
+//
+//	"start" is when it began to wait.
+//----------------------------------------------------------------------
+
+void
+LockStats::Waited(int start)
+{
+    int waited = stats->totalTicks - start;
+
+    contended++;
+    waitTicks += waited;
+    if (waited > maxWait)
+	maxWait = waited;
+}
+
+static LockStats *allLockStats = NULL;	// the statistics for each name
+
+//----------------------------------------------------------------------
+// FindLockStats
+// 	Return the statistics for the locks of a name, starting them if
+//	this is the first.  Only called when a lock is initialized, so
+//	we just search the list.
+//
+//	"lockName" is the name.
+//----------------------------------------------------------------------
+
+LockStats *
+FindLockStats(char *lockName)
+{
+    LockStats *ls;
+
+    for (ls = allLockStats; ls != NULL; ls = ls->next)
+	if (!strcmp(ls->name, lockName))
+	    return ls;
+    ls = new LockStats(lockName);
+    ls->next = allLockStats;
+    allLockStats = ls;
+    return ls;
+}
+
+//----------------------------------------------------------------------
+// PrintLockStats
+// 	Print the statistics for every name of lock acquired at least
+//	once, the ones waited for longest first -- these are where the
+//	threads get in each other's way.
+//----------------------------------------------------------------------
+
+void
+PrintLockStats()
+{
+    LockStats *ls, **sorted;
+    int n = 0, i, j;
+
+    for (ls = allLockStats; ls != NULL; ls = ls->next)
+	n++;
+    sorted = new LockStats *[n + 1];
+    for (ls = allLockStats, n = 0; ls != NULL; ls = ls->next) {
+	if (ls->acquires == 0)
+	    continue;
+	for (j = n++; j > 0 && sorted[j - 1]->waitTicks < ls->waitTicks; j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = ls;
+    }
+    printf("Locks: acquired, contended, waited (longest), held\n");
+    for (i = 0; i < n; i++)
+	printf("  %s: %d, %d, %d (%d), %d\n", sorted[i]->name, 
+	       sorted[i]->acquires, sorted[i]->contended, sorted[i]->waitTicks,
+	       sorted[i]->maxWait, sorted[i]->holdTicks);
+    delete [] sorted;
+}
+
+//----------------------------------------------------------------------
+// Donate
+// 	Set the priority a thread has been lent by threads waiting for
+//	locks it holds, and if that changes the priority it runs at, let
+//	the scheduler know.
+//
+//	"thread" is the thread; "priority" is the priority lent it, or 0.
+//----------------------------------------------------------------------
+
+static void
+Donate(Thread *thread, int priority)
+{
+    int oldPriority = thread->getPriority();
+
+    thread->donated = priority;
+    if (thread->getPriority() != oldPriority)
+	scheduler->PriorityChanged(thread, oldPriority);
+}
+
+//----------------------------------------------------------------------
+// Lock::Lock
+// 	Initialize a lock, so that it can be used for synchronization.
+//	It starts out FREE.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+Lock::Lock(char* debugName)
+{
+    name = debugName;
+    owner = NULL;
+    lockStats = FindLockStats(debugName);
+    busySince = 0;
+}
+
+//----------------------------------------------------------------------
+// Lock::~Lock
+// 	De-allocate a lock, when no longer needed.  No one may still be
+//	waiting for it.
+//----------------------------------------------------------------------
+
+Lock::~Lock()
+{
+    ASSERT(queue.IsEmpty());
+}
+
+//----------------------------------------------------------------------
+// Lock::isHeldByCurrentThread
+// 	Return TRUE if the current thread holds the lock.
+//----------------------------------------------------------------------
+
+bool
+Lock::isHeldByCurrentThread()
+{
+    return (owner == currentThread);
+}
+
+//----------------------------------------------------------------------
+// Lock::Acquire
+// 	Wait until the lock is FREE, then take it.  If it is FREE already,
+//	that is all there is to it.  Otherwise, go on the queue of
+//	threads waiting for it, lend our priority to the thread holding 
+//	it (and on down the chain, if that one is waiting for a lock in 
+//	turn), and sleep until Release hands the lock over to us.
+//
+//	As with Semaphore::P, interrupts are disabled, so this is atomic.
+//----------------------------------------------------------------------
+
+void
+Lock::Acquire()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Lock *lock;
+    int priority, start;
+
+    ASSERT(!isHeldByCurrentThread());		// locks don't nest
+    lockStats->acquires++;
+    if (owner == NULL) {			// FREE: the fast path
+	owner = currentThread;
+	busySince = stats->totalTicks;
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
+
+    start = stats->totalTicks;
+    DEBUG('s', "Thread \"%s\" waiting for lock \"%s\", held by \"%s\"\n",
+	  currentThread->getName(), name, owner->getName());
+    if (queue.IsEmpty())
+	owner->contended.Append(this);
+    queue.Append(currentThread);
+    currentThread->waitingFor = this;
+    priority = currentThread->getPriority();
+    for (lock = this; lock != NULL && lock->owner->getPriority() < priority;
+					lock = lock->owner->waitingFor)
+	Donate(lock->owner, priority);
+
+    scheduler->Blocked(currentThread);
+    currentThread->Sleep();
+    ASSERT(isHeldByCurrentThread());		// handed over by Release
+    lockStats->Waited(start);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::Release
+// 	Give up the lock, handing it to the most important thread 
+//	waiting for it, if any.  If that one should run instead of us
+//	(since we may have been running at its priority until now), let
+//	it.
+//----------------------------------------------------------------------
+
+void
+Lock::Release()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *next = Unlock();
+
+    if (next != NULL && scheduler->ShouldPreempt(next))
+	currentThread->Yield();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::Unlock
+// 	Give up the lock, without giving up the CPU.  If no one is waiting
+//	for it, it is just FREE again.  Otherwise, hand it to the most
+//	important waiter, and make that thread ready (the lock is BUSY
+//	all along, as far as the statistics go).  We lose whatever
+//	priority the threads waiting for this lock lent us, and the new
+//	owner gains whatever the ones still waiting lend it.
+//
+//	Called with interrupts disabled.
+//
+// Returns:
+//	The new owner, or NULL if the lock is FREE.
+//----------------------------------------------------------------------
+
+Thread *
+Lock::Unlock()
+{
+    Thread *next;
+    Lock *lock;
+    int priority;
+
+    ASSERT(isHeldByCurrentThread());
+    if (queue.IsEmpty()) {			// the fast path
+	owner = NULL;
+	lockStats->holdTicks += stats->totalTicks - busySince;
+	return NULL;
+    }
+
+    next = MostImportantWaiter();
+    (void) queue.Remove(next);
+    next->waitingFor = NULL;
+
+    (void) owner->contended.Remove(this);
+    priority = 0;
+    for (lock = owner->contended.First(); lock != NULL; 
+				lock = owner->contended.Next(lock))
+	if (lock->MostImportantWaiter()->getPriority() > priority)
+	    priority = lock->MostImportantWaiter()->getPriority();
+    Donate(owner, priority);
+
+    owner = next;
+    if (!queue.IsEmpty()) {
+	owner->contended.Append(this);
+	priority = MostImportantWaiter()->getPriority();
+	if (priority > owner->donated)
+	    Donate(owner, priority);
+    }
+    scheduler->ReadyToRun(next);
+    return next;
+}
+
+//----------------------------------------------------------------------
+// Lock::MostImportantWaiter
+// 	Return the thread waiting for the lock with the highest priority,
+//	and of those, the one that has waited longest; or NULL if no
+//	one is waiting.
+//----------------------------------------------------------------------
+
+Thread *
+Lock::MostImportantWaiter()
+{
+    Thread *best = NULL;
+
+    for (Thread *t = queue.First(); t != NULL; t = queue.Next(t))
+	if (best == NULL || t->getPriority() > best->getPriority())
+	    best = t;
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Condition::Condition
+// 	Initialize a condition variable, with no one waiting on it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
 
-Condition::Condition(char* debugName) { }
-Condition::~Condition() { }
-void Condition::Wait(Lock* conditionLock) { ASSERT(FALSE); }
-void Condition::Signal(Lock* conditionLock) { }
-void Condition::Broadcast(Lock* conditionLock) { }
+Condition::Condition(char* debugName)
+{
+    name = debugName;
+}
+
+//----------------------------------------------------------------------
+// Condition::~Condition
+// 	De-allocate a condition variable.  No one may still be waiting
+//	on it.
+//----------------------------------------------------------------------
+
+Condition::~Condition()
+{
+    ASSERT(queue.IsEmpty());
+}
+
+//----------------------------------------------------------------------
+// Condition::Wait
+// 	Release the lock, wait to be signalled, and then acquire the
+//	lock again.  Releasing the lock and going to sleep are atomic:
+//	we go on the queue before we let go of the lock, and we don't
+//	give up the CPU in between, so that a Signal can't be lost.
+//
+//	"conditionLock" is the lock protecting the condition; the current
+//	thread must hold it.
+//----------------------------------------------------------------------
+
+void
+Condition::Wait(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    queue.Append(currentThread);
+    (void) conditionLock->Unlock();
+    scheduler->Blocked(currentThread);
+    currentThread->Sleep();
+    conditionLock->Acquire();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Signal
+// 	Wake up the thread that has waited longest on the condition, if 
+//	there is one.  (Mesa semantics: it has to acquire the lock again
+//	before it returns from Wait, so it won't run until we release
+//	it.)
+//
+//	"conditionLock" is the lock protecting the condition; the current
+//	thread must hold it.
+//----------------------------------------------------------------------
+
+void
+Condition::Signal(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    thread = queue.Remove();
+    if (thread != NULL)
+	scheduler->ReadyToRun(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Broadcast
+// 	Wake up every thread waiting on the condition.
+//
+//	"conditionLock" is the lock protecting the condition; the current
+//	thread must hold it.
+//----------------------------------------------------------------------
+
+void
+Condition::Broadcast(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    while ((thread = queue.Remove()) != NULL)
+	scheduler->ReadyToRun(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a reader-writer lock.  It starts out FREE.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    readers = 0;
+    writer = NULL;
+    lockStats = FindLockStats(debugName);
+    busySince = 0;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	De-allocate a reader-writer lock.  No one may still be waiting
+//	for it.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    ASSERT(readQueue.IsEmpty() && writeQueue.IsEmpty());
+}
+
+//----------------------------------------------------------------------
+// RWLock::isWriteHeldByCurrentThread
+// 	Return TRUE if the current thread holds the lock to write.
+//----------------------------------------------------------------------
+
+bool
+RWLock::isWriteHeldByCurrentThread()
+{
+    return (writer == currentThread);
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead
+// 	Hold the lock to read.  If no thread holds it to write, or is
+//	waiting to, that is all there is to it.  Otherwise, wait until
+//	ReleaseWrite lets us in.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireRead()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int start;
+
+    lockStats->acquires++;
+    if (writer == NULL && writeQueue.IsEmpty()) {	// the fast path
+	if (readers++ == 0)
+	    busySince = stats->totalTicks;
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
+
+    start = stats->totalTicks;
+    DEBUG('s', "Thread \"%s\" waiting to read \"%s\"\n",
+	  currentThread->getName(), name);
+    readQueue.Append(currentThread);
+    scheduler->Blocked(currentThread);
+    currentThread->Sleep();			// counted in by ReleaseWrite
+    lockStats->Waited(start);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseRead
+// 	Stop reading.  If we were the last reader, hand the lock to the
+//	first writer waiting for it, if any.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseRead()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(readers > 0);
+    if (--readers == 0) {
+	writer = writeQueue.Remove();
+	if (writer != NULL)
+	    scheduler->ReadyToRun(writer);
+	else
+	    lockStats->holdTicks += stats->totalTicks - busySince;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite
+// 	Hold the lock to write.  If no one holds it at all, that is all
+//	there is to it.  Otherwise, wait until the lock is handed to us.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireWrite()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int start;
+
+    ASSERT(!isWriteHeldByCurrentThread());	// locks don't nest
+    lockStats->acquires++;
+    if (writer == NULL && readers == 0) {	// the fast path
+	writer = currentThread;
+	busySince = stats->totalTicks;
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
+
+    start = stats->totalTicks;
+    DEBUG('s', "Thread \"%s\" waiting to write \"%s\"\n",
+	  currentThread->getName(), name);
+    writeQueue.Append(currentThread);
+    scheduler->Blocked(currentThread);
+    currentThread->Sleep();
+    ASSERT(isWriteHeldByCurrentThread());	// handed over to us
+    lockStats->Waited(start);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseWrite
+// 	Stop writing.  Hand the lock to the next writer waiting for it,
+//	if any; otherwise let in all the readers waiting for it.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseWrite()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(isWriteHeldByCurrentThread());
+    writer = writeQueue.Remove();
+    if (writer != NULL)
+	scheduler->ReadyToRun(writer);
+    else if (!readQueue.IsEmpty()) {
+	while ((thread = readQueue.Remove()) != NULL) {
+	    readers++;
+	    scheduler->ReadyToRun(thread);
+	}
+    } else
+	lockStats->holdTicks += stats->totalTicks - busySince;
+    (void) interrupt->SetLevel(oldLevel);
+}
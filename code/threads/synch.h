@@ -1,11 +1,8 @@
 // synch.h 
 //	Data structures for synchronizing threads.
 //
-//	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
-//	semaphores is given; for the latter two, only the procedure
-//	interface is given -- they are to be implemented as part of 
-//	the first assignment.
+//	Four kinds of synchronization are defined here: semaphores,
+//	locks, condition variables, and reader-writer locks.
 //
 //	Note that all the synchronization objects take a "name" as
 //	part of the initialization.  This is solely for debugging purposes.
@@ -19,7 +16,7 @@
 
 #include "copyright.h"
 #include "thread.h"
-#include "list.h"
+#include "ilist.h"
 
 // The following class defines a "semaphore" whose value is a non-negative
 // integer.  The semaphore has only two operations P() and V():
@@ -27,6 +24,12 @@
 //	P() -- waits until value > 0, then decrement
 //
 //	V() -- increment, waking up a thread waiting in P() if necessary
+//
+// P(n) and V(n) do the same n at a time, e.g. to wait for n of a batch
+// of I/O requests to complete at once.  Waiters are served in order: a
+// thread waiting for more than the value holds up those behind it, and
+// a new P(n) waits behind them all, so that small requests can't starve
+// a big one.
 // 
 // Note that the interface does *not* allow a thread to read the value of 
 // the semaphore directly -- even if you did read the value, the
@@ -42,15 +45,46 @@ class Semaphore {
     ~Semaphore();   					// de-allocate semaphore
     char* getName() { return name;}			// debugging assist
     
-    void P();	 // these are the only operations on a semaphore
-    void V();	 // they are both *atomic*
+    void P() { P(1); } // these are the only operations on a semaphore
+    void V() { V(1); } // they are all *atomic*
+    void P(int n);
+    void V(int n);
     
   private:
     char* name;        // useful for debugging
     int value;         // semaphore value, always >= 0
-    List *queue;       // threads waiting in P() for the value to be > 0
+    IList<Thread> queue; // threads waiting in P() for the value to be 
+			 // big enough
+};
+
+// The following class defines the statistics kept for locks.  They are
+// kept by name: all the locks with the same name (say, the lock of each
+// mailbox) share one LockStats, so that it is the kind of lock that a 
+// thread spends its time waiting for that shows up.  Times are in ticks.
+
+class LockStats {
+  public:
+    LockStats(char *lockName);		// initialize them to zero
+
+    char *name;				// of the locks
+    int acquires;			// times one was acquired
+    int contended;			// times a thread had to wait for one
+    int waitTicks;			// how long threads waited, in all
+    int maxWait;			// the longest wait
+    int holdTicks;			// how long they were held, in all
+					// (from FREE until FREE again)
+
+    LockStats *next;			// the next on the list of them all
+
+    void Waited(int start);		// Count a wait that began at "start"
 };
 
+extern LockStats *FindLockStats(char *lockName); // The statistics for the
+					// locks named "lockName", 
+					// starting them if need be
+extern void PrintLockStats();		// Print them all, the locks waited
+					// for longest first
+
 // The following class defines a "lock".  A lock can be BUSY or FREE.
 // There are only two operations allowed on a lock: 
 //
@@ -62,6 +96,16 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// Acquiring a FREE lock, and releasing one no one is waiting for, 
+// just set the owner.  Otherwise, a lock is handed straight from
+// the thread releasing it to the most important thread waiting for
+// it, and while a thread waits, the holder -- and whoever holds the
+// lock that one is waiting for, and so on -- runs at the waiter's 
+// priority, if that is higher than its own ("priority inheritance"). 
+// Otherwise a thread of middling priority could keep the holder from
+// running, and so keep the more important thread waiting, however 
+// long it likes.
 
 class Lock {
   public:
@@ -77,9 +121,22 @@ class Lock {
 					// checking in Release, and in
 					// Condition variable ops below.
 
+    ListLink<Lock> link;		// for the list of contended locks
+					// its owner holds
+
   private:
     char* name;				// for debugging
-    // plus some other stuff you'll need to define
+    Thread *owner;			// the thread holding it; NULL if FREE
+    IList<Thread> queue;		// threads waiting for it in Acquire()
+    LockStats *lockStats;		// shared by the locks of this name
+    int busySince;			// when it was last acquired, while
+					// FREE
+
+    Thread *MostImportantWaiter();	// the thread waiting for it that
+					// has the highest priority, if any
+    Thread *Unlock();			// Release, without giving up the 
+					// CPU; returns the new owner, if any
+    friend class Condition;
 };
 
 // The following class defines a "condition variable".  A condition
@@ -131,6 +188,51 @@ class Condition {
 
   private:
     char* name;
-    // plus some other stuff you'll need to define
+    IList<Thread> queue;		// threads waiting in Wait()
 };
+
+// The following class defines a "reader-writer lock": one that any number
+// of threads may hold at once to read the data it protects, or one 
+// thread alone to write it.
+//
+//	AcquireRead -- wait until no thread holds the lock to write (or 
+//		is waiting to), then hold it to read
+//
+//	AcquireWrite -- wait until no thread holds the lock at all, then
+//		hold it to write
+//
+//	ReleaseRead, ReleaseWrite -- let it go again
+//
+// Writers are preferred: once a writer is waiting, new readers wait 
+// behind it, and when a writer is done, the lock goes to the next
+// writer, if any, before the readers waiting for it.  So readers can't
+// keep a writer out for ever (though a steady stream of writers can
+// keep readers out).  Unlike Lock, there is no priority inheritance.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize lock to be FREE
+    ~RWLock();				// deallocate lock
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireRead();			// these are all *atomic*
+    void ReleaseRead();
+    void AcquireWrite();
+    void ReleaseWrite();
+
+    bool isWriteHeldByCurrentThread();	// true if the current thread
+					// holds it to write
+
+  private:
+    char* name;				// for debugging
+    int readers;			// how many threads hold it to read
+    Thread *writer;			// the thread holding it to write, 
+					// if any
+    IList<Thread> readQueue;		// threads waiting to read,
+    IList<Thread> writeQueue;		// and to write
+    LockStats *lockStats;		// shared by the locks of this name
+    int busySince;			// when it was last acquired, while
+					// FREE
+};
+
 #endif // SYNCH_H
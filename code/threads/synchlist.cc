@@ -1,9 +1,12 @@
 // synchlist.cc
 //	Routines for synchronized access to a list.
 //
-//	Implemented by surrounding the List abstraction
+//	Implemented by surrounding the IList abstraction
 //	with synchronization routines.
 //
+//	Since SynchList is a template, this file isn't compiled by
+//	itself; synchlist.h includes it.
+//
 // 	Implemented in "monitor"-style -- surround each procedure with a
 // 	lock acquire and release pair, using condition signal and wait for
 // 	synchronization.
@@ -22,9 +25,9 @@
 //	Elements can now be added to the list.
 //----------------------------------------------------------------------
 
-SynchList::SynchList()
+template <class T>
+SynchList<T>::SynchList()
 {
-    list = new List();
     lock = new Lock("list lock"); 
     listEmpty = new Condition("list empty cond");
 }
@@ -34,9 +37,9 @@ SynchList::SynchList()
 //	De-allocate the data structures created for synchronizing a list. 
 //----------------------------------------------------------------------
 
-SynchList::~SynchList()
+template <class T>
+SynchList<T>::~SynchList()
 { 
-    delete list; 
     delete lock;
     delete listEmpty;
 }
@@ -46,15 +49,15 @@ SynchList::~SynchList()
 //      Append an "item" to the end of the list.  Wake up anyone
 //	waiting for an element to be appended.
 //
-//	"item" is the thing to put on the list, it can be a pointer to 
-//		anything.
+//	"item" is the thing to put on the list.
 //----------------------------------------------------------------------
 
+template <class T>
 void
-SynchList::Append(void *item)
+SynchList<T>::Append(T *item)
 {
     lock->Acquire();		// enforce mutual exclusive access to the list 
-    list->Append(item);
+    list.Append(item);
     listEmpty->Signal(lock);	// wake up a waiter, if any
     lock->Release();
 }
@@ -67,15 +70,16 @@ SynchList::Append(void *item)
 //	The removed item. 
 //----------------------------------------------------------------------
 
-void *
-SynchList::Remove()
+template <class T>
+T *
+SynchList<T>::Remove()
 {
-    void *item;
+    T *item;
 
     lock->Acquire();			// enforce mutual exclusion
-    while (list->IsEmpty())
+    while (list.IsEmpty())
 	listEmpty->Wait(lock);		// wait until list isn't empty
-    item = list->Remove();
+    item = list.Remove();
     ASSERT(item != NULL);
     lock->Release();
     return item;
@@ -89,10 +93,11 @@ SynchList::Remove()
 //	"func" is the procedure to be applied.
 //----------------------------------------------------------------------
 
+template <class T>
 void
-SynchList::Mapcar(VoidFunctionPtr func)
+SynchList<T>::Mapcar(VoidFunctionPtr func)
 { 
     lock->Acquire(); 
-    list->Mapcar(func);
+    list.Mapcar(func);
     lock->Release(); 
 }
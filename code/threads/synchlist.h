@@ -1,8 +1,10 @@
 // synchlist.h 
 //	Data structures for synchronized access to a list.
 //
-//	Implemented by surrounding the List abstraction
-//	with synchronization routines.
+//	Implemented by surrounding the IList abstraction
+//	with synchronization routines.  Like IList, it's a template:
+//	a SynchList<T> holds items of class T, which must have a 
+//	"ListLink<T> link" member (see ilist.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -12,7 +14,7 @@
 #define SYNCHLIST_H
 
 #include "copyright.h"
-#include "list.h"
+#include "ilist.h"
 #include "synch.h"
 
 // The following class defines a "synchronized list" -- a list for which:
@@ -21,22 +23,26 @@
 //	wait until the list has an element on it.
 //	2. One thread at a time can access list data structures
 
+template <class T>
 class SynchList {
   public:
     SynchList();		// initialize a synchronized list
     ~SynchList();		// de-allocate a synchronized list
 
-    void Append(void *item);	// append item to the end of the list,
+    void Append(T *item);	// append item to the end of the list,
 				// and wake up any thread waiting in remove
-    void *Remove();		// remove the first item from the front of
+    T *Remove();		// remove the first item from the front of
 				// the list, waiting if the list is empty
 				// apply function to every item in the list
     void Mapcar(VoidFunctionPtr func);
 
   private:
-    List *list;			// the unsynchronized list
+    IList<T> list;		// the unsynchronized list
     Lock *lock;			// enforce mutual exclusive access to the list
     Condition *listEmpty;	// wait in Remove if the list is empty
 };
 
+#include "synchlist.cc"		// the routines are templates, so every
+				// user of a SynchList needs them
+
 #endif // SYNCHLIST_H
@@ -7,6 +7,7 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "synch.h"
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -18,8 +19,9 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+ReplayLog *replayLog;			// the run being recorded or replayed
 
-Thread* mask[128];
+ThreadTable *threadTable;		// all the threads, by ID
 
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
@@ -31,6 +33,8 @@ SynchDisk   *synchDisk;
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+BitMap *frameMap;	// the page frames in use, by any address space
+Thread *cpuThread[MaxCPUs];	// the thread on each CPU, or NULL if idle
 #endif
 
 #ifdef NETWORK
@@ -42,12 +46,30 @@ PostOffice *postOffice;
 extern void Cleanup();
 
 
+//----------------------------------------------------------------------
+// SaveReplayLog
+// 	Nachos is aborting: write out the part of the run recorded so
+//	far, so that it can be replayed up to the crash.
+//----------------------------------------------------------------------
+
+static void
+SaveReplayLog()
+{
+    if (replayLog != NULL)
+	replayLog->Flush();
+}
+
 //----------------------------------------------------------------------
 // TimerInterruptHandler
-// 	Interrupt handler for the timer device.  The timer device is
-//	set up to interrupt the CPU periodically (once every TimerTicks).
-//	This routine is called each time there is a timer interrupt,
-//	with interrupts disabled.
+// 	Interrupt handler for the timer device.  The scheduler sets the
+//	timer to go off when the running thread's quantum is up (or, with
+//	-rs, it goes off at random).  This routine is called each time 
+//	there is a timer interrupt, with interrupts disabled.
+//
+//	Whether the interrupted thread should give up the CPU is up to
+//	the scheduler: with some policies, it may run on.  If the CPU
+//	is idle, the timer has nothing to do; it is set again when a
+//	thread next runs.
 //
 //	Note that instead of calling Yield() directly (which would
 //	suspend the interrupt handler, not the interrupted thread
@@ -62,10 +84,43 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(int dummy)
 {
-    if (interrupt->getStatus() != IdleMode)
+    if (interrupt->getStatus() != IdleMode && scheduler->QuantumExpired())
 	interrupt->YieldOnReturn();
 }
 
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// MemoryToPages
+// 	Convert the argument of -mem into a number of page frames.
+//	A plain number is a count of pages; a number followed by K, M 
+//	or G is an amount of memory, rounded up to a whole page.
+//
+//	"arg" -- the argument, e.g. "64" or "16M"
+//	"pageSize" -- the size of a page, in bytes
+//----------------------------------------------------------------------
+
+static int
+MemoryToPages(char *arg, int pageSize)
+{
+    double bytes = atoi(arg);
+
+    switch (arg[strlen(arg) - 1]) {
+      case 'K': case 'k':
+	bytes *= 1024;
+	break;
+      case 'M': case 'm':
+	bytes *= 1024 * 1024;
+	break;
+      case 'G': case 'g':
+	bytes *= 1024 * 1024 * 1024;
+	break;
+      default:
+	return (int) bytes;		// already in pages
+    }
+    return (int) ((bytes + pageSize - 1) / pageSize);
+}
+#endif
+
 //----------------------------------------------------------------------
 // Initialize
 // 	Initialize Nachos global data structures.  Interpret command
@@ -82,9 +137,21 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    char *policyName = "priority";	// how to choose the next thread
+    char *quanta = NULL;		// the time slices it hands out
+    char *recordFile = NULL;		// where to log the schedule,
+    char *replayFile = NULL;		// or where to replay it from
+    SchedulingPolicy *policy;
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    EngineType engine = InterpretEngine;  // how to run user code
+    char *memArg = NULL;	// size of physical memory
+    int pageSize = DefaultPageSize;
+    int tlbSize = DefaultTLBSize;
+    int numCPUs = 1;		// number of CPUs
+    int cpuSlice = 1;		// ticks each CPU runs before the next
+    int hostCPUs = 1;		// host threads to run CPUs on
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -109,10 +176,55 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-sched")) {
+	    ASSERT(argc > 1);
+	    policyName = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-quanta")) {
+	    ASSERT(argc > 1);
+	    quanta = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-record")) {
+	    ASSERT(argc > 1);
+	    recordFile = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-replay")) {
+	    ASSERT(argc > 1);
+	    replayFile = *(argv + 1);
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-b"))
+	    engine = BlockEngine;
+	else if (!strcmp(*argv, "-j"))
+	    engine = CompileEngine;
+	else if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    memArg = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pagesize")) {
+	    ASSERT(argc > 1);
+	    pageSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    tlbSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cpus")) {
+	    ASSERT(argc > 1);
+	    numCPUs = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cpuslice")) {
+	    ASSERT(argc > 1);
+	    cpuSlice = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-hostcpus")) {
+	    ASSERT(argc > 1);
+	    hostCPUs = atoi(*(argv + 1));
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -134,10 +246,20 @@ Initialize(int argc, char **argv)
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
     interrupt = new Interrupt;			// start up interrupt handling
-    scheduler = new Scheduler();		// initialize the ready queue
-    if (randomYield)				// start the timer (if needed)
-	timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    policy = NewSchedulingPolicy(policyName, quanta);
+    ASSERT(policy != NULL);			// no such policy
+    scheduler = new Scheduler(policy);		// initialize the ready queue
+    replayLog = NULL;
+    if (replayFile != NULL) {			// the timer goes off as it
+	replayLog = new ReplayLog(replayFile, TRUE, FALSE); // did then
+	randomYield = replayLog->RandomTimer();
+    } else if (recordFile != NULL)
+	replayLog = new ReplayLog(recordFile, FALSE, randomYield);
+    CallOnAbort(SaveReplayLog);			// if an ASSERT fails
+    timer = new Timer(TimerInterruptHandler, 0, randomYield); // start the
+						// timer, for time slicing
 
+    threadTable = new ThreadTable;		// before any thread is created
     threadToBeDestroyed = NULL;
 
     // We didn't explicitly allocate the current thread we are running in.
@@ -150,7 +272,17 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    SetMemoryGeometry((memArg == NULL) ? DefaultNumPhysPages
+			: MemoryToPages(memArg, pageSize), pageSize, tlbSize);
+    machine = new Machine(debugUserProg, engine, numCPUs); // this must 
+							   // come first
+    frameMap = new BitMap(NumPhysPages);	// all of memory is free
+    cpuThread[0] = currentThread;		// we start out on CPU 0
+    if (numCPUs > 1) {
+	if (hostCPUs > 1)
+	    machine->UseHostThreads(hostCPUs);
+	interrupt->StartCPUSlices(cpuSlice);
+    }
 #endif
 
 #ifdef FILESYS
@@ -174,12 +306,15 @@ void
 Cleanup()
 {
     printf("\nCleaning up...\n");
+    if (DebugIsEnabled('s'))
+	PrintLockStats();		// where threads waited for each other
 #ifdef NETWORK
     delete postOffice;
 #endif
     
 #ifdef USER_PROGRAM
     delete machine;
+    delete frameMap;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -191,6 +326,8 @@ Cleanup()
 #endif
     
     delete timer;
+    delete replayLog;				// write out the rest of it
+    replayLog = NULL;
     delete scheduler;
     delete interrupt;
     
@@ -199,8 +336,6 @@ Cleanup()
 
 // Display all threads
 void Ts(void) {
-	for (int i = 0; i < 128; i++) if (mask[i]) {
-		mask[i]->Print();
-	}
+	threadTable->Mapcar(ThreadPrint);
 }
 
@@ -11,10 +11,12 @@
 #include "copyright.h"
 #include "utility.h"
 #include "thread.h"
+#include "threadtable.h"
 #include "scheduler.h"
 #include "interrupt.h"
 #include "stats.h"
 #include "timer.h"
+#include "replay.h"
 
 // Initialization and cleanup routines
 extern void Initialize(int argc, char **argv); 	// Initialization,
@@ -28,12 +30,18 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern ReplayLog *replayLog;			// the run being recorded or
+						// replayed, if any
 
-extern Thread* mask[128];
+extern ThreadTable *threadTable;		// all the threads, by ID
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "bitmap.h"
 extern Machine* machine;	// user program memory and registers
+extern BitMap *frameMap;	// the page frames of physical memory
+				// that are in use
+extern Thread *cpuThread[MaxCPUs];	// the thread on each CPU, or NULL
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -0,0 +1,454 @@
+// taskruntime.cc
+//	Routines for a runtime of parallel tasks.  See taskruntime.h.
+//
+//	As in synch.cc, we keep the deques and queues consistent by
+//	disabling interrupts while we look at or change them; a task
+//	itself runs with interrupts enabled.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "taskruntime.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// TaskGroup::TaskGroup
+// 	Initialize a group with no tasks in it.
+//----------------------------------------------------------------------
+
+TaskGroup::TaskGroup()
+{
+    pending = 0;
+    waiter = NULL;
+}
+
+//----------------------------------------------------------------------
+// TaskGroup::~TaskGroup
+// 	De-allocate a group.  Its tasks must be done; Sync first.
+//----------------------------------------------------------------------
+
+TaskGroup::~TaskGroup()
+{
+    ASSERT(pending == 0);
+}
+
+//----------------------------------------------------------------------
+// TaskDeque::TaskDeque
+// 	Initialize an empty deque.
+//----------------------------------------------------------------------
+
+TaskDeque::TaskDeque()
+{
+    size = InitialDequeSize;
+    tasks = new Task *[size];
+    top = bottom = 0;
+}
+
+//----------------------------------------------------------------------
+// TaskDeque::~TaskDeque
+// 	De-allocate a deque.  The tasks in it belong to someone else.
+//----------------------------------------------------------------------
+
+TaskDeque::~TaskDeque()
+{
+    delete [] tasks;
+}
+
+//----------------------------------------------------------------------
+// TaskDeque::Push
+// 	Put a task on the bottom of the deque, making room first if
+//	it is full.
+//
+//	"task" is the task to put there.
+//----------------------------------------------------------------------
+
+void
+TaskDeque::Push(Task *task)
+{
+    if (bottom - top == size)
+	Grow();
+    tasks[bottom & (size - 1)] = task;
+    bottom++;
+}
+
+//----------------------------------------------------------------------
+// TaskDeque::Pop
+// 	Take the task off the bottom of the deque: the one pushed last.
+//
+// Returns:
+//	The task, or NULL if the deque is empty.
+//----------------------------------------------------------------------
+
+Task *
+TaskDeque::Pop()
+{
+    if (top == bottom)
+	return NULL;
+    bottom--;
+    return tasks[bottom & (size - 1)];
+}
+
+//----------------------------------------------------------------------
+// TaskDeque::Steal
+// 	Take the task off the top of the deque: the one pushed first.
+//
+// Returns:
+//	The task, or NULL if the deque is empty.
+//----------------------------------------------------------------------
+
+Task *
+TaskDeque::Steal()
+{
+    Task *task;
+
+    if (top == bottom)
+	return NULL;
+    task = tasks[top & (size - 1)];
+    top++;
+    return task;
+}
+
+//----------------------------------------------------------------------
+// TaskDeque::Grow
+// 	Double the size of the ring, keeping each task at the same index
+//	(modulo the new size).
+//----------------------------------------------------------------------
+
+void
+TaskDeque::Grow()
+{
+    Task **newTasks = new Task *[size * 2];
+
+    for (int i = top; i != bottom; i++)
+	newTasks[i & (size * 2 - 1)] = tasks[i & (size - 1)];
+    delete [] tasks;
+    tasks = newTasks;
+    size *= 2;
+}
+
+//----------------------------------------------------------------------
+// TaskWorker
+// 	Dummy function, because C++ does not allow a pointer to a member
+//	function; each worker starts here.
+//
+//	"arg" is the runtime.
+//----------------------------------------------------------------------
+
+static void
+TaskWorker(int arg)
+{
+    TaskRuntime *runtime = (TaskRuntime *) arg;
+
+    runtime->Work();
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::TaskRuntime
+// 	Fork the workers of a runtime.  They park until there are tasks
+//	for them.
+//
+//	"debugName" is an arbitrary name, useful for debugging; it is
+//		also the name of each worker.
+//	"numWorkers" is how many workers there are.
+//----------------------------------------------------------------------
+
+TaskRuntime::TaskRuntime(char *debugName, int howMany)
+{
+    int i;
+
+    ASSERT(howMany > 0);
+    name = debugName;
+    numWorkers = howMany;
+    workers = new Thread *[numWorkers];
+    deques = new TaskDeque[numWorkers];
+    finishing = FALSE;
+    running = numWorkers;
+    finisher = NULL;
+    numSpawned = numStolen = 0;
+    for (i = 0; i < numWorkers; i++)
+	workers[i] = new Thread(name);
+    for (i = 0; i < numWorkers; i++)
+	workers[i]->Fork(TaskWorker, (int) this);
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::~TaskRuntime
+// 	Tell the workers to finish, once they have run all the tasks
+//	spawned, and wait until they have; then de-allocate the runtime.
+//
+//	Must not be called by a worker.
+//----------------------------------------------------------------------
+
+TaskRuntime::~TaskRuntime()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+    Task *task;
+
+    ASSERT(CurrentWorker() < 0);
+    finishing = TRUE;
+    while ((thread = parked.Remove()) != NULL)
+	scheduler->ReadyToRun(thread);
+    while (running > 0) {
+	finisher = currentThread;
+	scheduler->Blocked(currentThread);
+	currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+
+    while ((task = freeTasks.Remove()) != NULL)
+	delete task;
+    delete [] deques;
+    delete [] workers;			// they have de-allocated themselves
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::Spawn
+// 	Hand a task to the runtime: put it on the bottom of the current
+//	worker's deque, or if this isn't a worker, on the shared queue.
+//	If a worker is parked, wake it up, to run it (or to steal some
+//	other task).
+//
+//	"group" is the group to count the task in; Sync it later.
+//	"func" is the procedure for a worker to call
+//	"arg" is the argument to pass to it
+//----------------------------------------------------------------------
+
+void
+TaskRuntime::Spawn(TaskGroup *group, VoidFunctionPtr func, int arg)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int worker = CurrentWorker();
+    Task *task = freeTasks.Remove();
+    Thread *thread;
+
+    if (task == NULL)
+	task = new Task;
+    task->func = func;
+    task->arg = arg;
+    task->group = group;
+    group->pending++;
+    numSpawned++;
+    if (worker >= 0)
+	deques[worker].Push(task);
+    else
+	shared.Append(task);
+    if ((thread = parked.Remove()) != NULL)
+	scheduler->ReadyToRun(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::Sync
+// 	Wait until every task spawned in a group is done.  A worker runs
+//	the tasks it can find meanwhile -- its own first, so most likely
+//	those of the group -- and only sleeps when there are none left,
+//	and the group's are all running on other workers.
+//
+//	"group" is the group to wait for.
+//----------------------------------------------------------------------
+
+void
+TaskRuntime::Sync(TaskGroup *group)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int worker = CurrentWorker();
+    Task *task;
+
+    while (group->pending > 0) {
+	task = (worker >= 0) ? FindTask(worker) : NULL;
+	if (task != NULL)
+	    RunTask(task);
+	else {
+	    group->waiter = currentThread;
+	    scheduler->Blocked(currentThread);
+	    currentThread->Sleep();
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// ForRange
+// 	A piece of the range of a ParallelFor, still to be done.  A task
+//	running one splits off the top half for another task to do, until
+//	it is small enough to do itself.  So the first pieces stolen are
+//	the biggest.
+//----------------------------------------------------------------------
+
+class ForRange {
+  public:
+    TaskRuntime *runtime;
+    TaskGroup *group;
+    int from, to, grain;
+    VoidFunctionPtr body;
+};
+
+static void
+ForTask(int arg)
+{
+    ForRange *range = (ForRange *) arg;
+    ForRange *half;
+    int i;
+
+    while (range->to - range->from > range->grain) {
+	half = new ForRange;
+	*half = *range;
+	half->from = range->from + (range->to - range->from) / 2;
+	range->to = half->from;
+	range->runtime->Spawn(range->group, ForTask, (int) half);
+    }
+    for (i = range->from; i < range->to; i++)
+	(*range->body)(i);
+    delete range;
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::ParallelFor
+// 	Call a procedure for each number in a range, in tasks, and wait
+//	for them all.
+//
+//	"from" is the first number
+//	"to" is one past the last
+//	"grain" is how many numbers a task should do, at least
+//	"body" is the procedure to call, for each number
+//----------------------------------------------------------------------
+
+void
+TaskRuntime::ParallelFor(int from, int to, int grain, VoidFunctionPtr body)
+{
+    TaskGroup group;
+    ForRange *range = new ForRange;
+
+    ASSERT(grain > 0);
+    range->runtime = this;
+    range->group = &group;
+    range->from = from;
+    range->to = to;
+    range->grain = grain;
+    range->body = body;
+    if (CurrentWorker() >= 0)		// start on it ourselves
+	ForTask((int) range);
+    else
+	Spawn(&group, ForTask, (int) range);
+    Sync(&group);
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::Work
+// 	The loop each worker runs: find a task and run it, or park until
+//	there might be one, until told to finish.
+//----------------------------------------------------------------------
+
+void
+TaskRuntime::Work()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int worker = CurrentWorker();
+    Task *task;
+
+    for (;;) {
+	if ((task = FindTask(worker)) != NULL)
+	    RunTask(task);
+	else if (finishing)
+	    break;
+	else {
+	    parked.Append(currentThread);
+	    scheduler->Blocked(currentThread);
+	    currentThread->Sleep();
+	}
+    }
+    running--;
+    if (running == 0 && finisher != NULL)
+	scheduler->ReadyToRun(finisher);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::Print
+// 	Print how many tasks have been spawned, and how many of those
+//	were stolen.
+//----------------------------------------------------------------------
+
+void
+TaskRuntime::Print()
+{
+    printf("Tasks \"%s\": %d workers, %d tasks spawned, %d stolen\n",
+	   name, numWorkers, numSpawned, numStolen);
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::CurrentWorker
+// 	Return which worker the current thread is, or -1 if it is not
+//	one of them.
+//----------------------------------------------------------------------
+
+int
+TaskRuntime::CurrentWorker()
+{
+    for (int i = 0; i < numWorkers; i++)
+	if (workers[i] == currentThread)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::FindTask
+// 	Find a task for a worker to run: the newest on its own deque,
+//	or else the oldest on the shared queue, or else steal the oldest
+//	from another worker, trying each in turn.  Called with interrupts
+//	disabled.
+//
+//	"worker" is the worker looking for a task.
+//
+// Returns:
+//	The task, or NULL if there are none.
+//----------------------------------------------------------------------
+
+Task *
+TaskRuntime::FindTask(int worker)
+{
+    Task *task;
+
+    if ((task = deques[worker].Pop()) != NULL)
+	return task;
+    if ((task = shared.Remove()) != NULL)
+	return task;
+    for (int i = 1; i < numWorkers; i++)
+	if ((task = deques[(worker + i) % numWorkers].Steal()) != NULL) {
+	    numStolen++;
+	    DEBUG('t', "Worker %d of \"%s\" stole a task from worker %d\n",
+		  worker, name, (worker + i) % numWorkers);
+	    return task;
+	}
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// TaskRuntime::RunTask
+// 	Run a task, with interrupts enabled, and when it is done, count
+//	it off its group, waking up the thread waiting in Sync if it was
+//	the last.  Called with interrupts disabled.
+//
+//	"task" is the task to run.
+//----------------------------------------------------------------------
+
+void
+TaskRuntime::RunTask(Task *task)
+{
+    VoidFunctionPtr func = task->func;
+    int arg = task->arg;
+    TaskGroup *group = task->group;
+
+    freeTasks.Append(task);
+    (void) interrupt->SetLevel(IntOn);
+    (*func)(arg);
+    (void) interrupt->SetLevel(IntOff);
+    group->pending--;
+    if (group->pending == 0 && group->waiter != NULL) {
+	scheduler->ReadyToRun(group->waiter);
+	group->waiter = NULL;
+    }
+}
@@ -0,0 +1,153 @@
+// taskruntime.h
+//	Data structures for a runtime of fine-grained parallel tasks, run
+//	by a fixed set of kernel worker threads.
+//
+//	A task is just a call (*func)(arg): much lighter than a thread,
+//	with no stack of its own, so a task can be spawned for each
+//	sector to checksum, or each packet to process.  Tasks spawned
+//	together belong to a TaskGroup; Sync waits until all of them are
+//	done.  A task may spawn and sync tasks of its own.
+//
+//	Each worker has a deque of tasks, in the style of Chase and Lev.
+//	A worker spawns onto, and takes work from, the bottom of its own
+//	deque -- most recent first, so that the tasks it works on are
+//	small, and their data is at hand.  A worker with nothing left
+//	to do "steals" from the top of some other worker's deque: the
+//	oldest task there, which is likely to be a big one, that will
+//	keep it busy for a while.  Tasks spawned by threads that aren't
+//	workers go on a shared queue.  A worker that can't find anything
+//	to do parks, until something is spawned.
+//
+//	A worker waiting in Sync runs other tasks meanwhile, rather than
+//	sleeping, until there are none to be found.
+//
+//	Chase and Lev's deque needs no locks: the owner and the thieves
+//	only contend, with an atomic instruction, over the last task.
+//	Here the threads only interleave when there is an interrupt, so
+//	disabling interrupts is enough, as for the ready list.
+//
+//	Usage:
+//		runtime = new TaskRuntime("tasks", 4);
+//		TaskGroup group;
+//		runtime->Spawn(&group, func, arg);	// (*func)(arg), on
+//		...					// some worker
+//		runtime->Sync(&group);		// wait for them all
+//
+//		runtime->ParallelFor(0, n, 16, body);	// body(i), for each
+//							// 0 <= i < n
+//		delete runtime;
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TASKRUNTIME_H
+#define TASKRUNTIME_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "ilist.h"
+#include "thread.h"
+
+class TaskGroup;
+
+// A task waiting to be run: call (*func)(arg), then tell "group".
+
+class Task {
+  public:
+    VoidFunctionPtr func;
+    int arg;
+    TaskGroup *group;
+    ListLink<Task> link;	// for the shared queue, or the tasks
+				// free for re-use
+};
+
+// The following class defines a set of tasks to wait for, together.
+// Only the thread that spawns them may Sync on them.
+
+class TaskGroup {
+  public:
+    TaskGroup();		// initialize an empty group
+    ~TaskGroup();		// de-allocate it; nothing may be pending
+
+    int Pending() { return pending; }
+
+  private:
+    friend class TaskRuntime;
+    int pending;		// tasks spawned, and not yet finished
+    Thread *waiter;		// the thread waiting for them, if any
+};
+
+// The following class defines the deque of tasks of one worker.  Only
+// the worker pushes and pops, at the bottom; other workers steal from
+// the top.  Called with interrupts disabled.
+
+#define InitialDequeSize 64	// how many tasks a deque has room for,
+				// to begin with
+
+class TaskDeque {
+  public:
+    TaskDeque();		// initialize an empty deque
+    ~TaskDeque();		// de-allocate it
+
+    void Push(Task *task);	// Put a task on the bottom
+    Task *Pop();		// Take the task from the bottom, or NULL
+    Task *Steal();		// Take the task from the top, or NULL
+    bool IsEmpty() { return top == bottom; }
+
+  private:
+    Task **tasks;		// a ring of them, from tasks[top % size]
+    int size;			// how big the ring is; a power of 2
+    int top;			// where the oldest task is
+    int bottom;			// where the next one pushed goes
+
+    void Grow();		// Double the size of the ring
+};
+
+// The following class defines the task runtime.
+
+class TaskRuntime {
+  public:
+    TaskRuntime(char *debugName, int numWorkers);
+				// Fork "numWorkers" worker threads
+    ~TaskRuntime();		// Wait for the tasks spawned to finish,
+				// then let the workers go
+
+    void Spawn(TaskGroup *group, VoidFunctionPtr func, int arg);
+				// Have a worker call (*func)(arg),
+				// some time before Sync(group)
+    void Sync(TaskGroup *group);
+				// Wait until the tasks of "group" are done
+    void ParallelFor(int from, int to, int grain, VoidFunctionPtr body);
+				// Call body(i) for each i from "from" up
+				// to "to" (not included), in parallel,
+				// in pieces of "grain" or so; and wait
+
+    void Work();		// What each worker thread does;
+				// internal to the runtime
+    void Print();		// Print how many tasks were spawned
+				// and stolen, for debugging
+
+  private:
+    char *name;			// useful for debugging
+    int numWorkers;		// how many workers there are
+    Thread **workers;		// the worker threads
+    TaskDeque *deques;		// and the deque of each
+    IList<Task> shared;		// tasks spawned by threads that aren't
+				// workers
+    IList<Task> freeTasks;	// tasks to re-use
+    IList<Thread> parked;	// workers with nothing to do
+    bool finishing;		// TRUE once the workers should finish
+    int running;		// workers that have not finished yet
+    Thread *finisher;		// the thread waiting for them, if any
+
+    int numSpawned;		// tasks spawned,
+    int numStolen;		// and how many of them stolen
+
+    int CurrentWorker();	// The current thread's worker number,
+				// or -1 if it isn't one
+    Task *FindTask(int worker);	// A task for a worker to run, or NULL
+    void RunTask(Task *task);	// Run a task, and tell its group
+};
+
+#endif // TASKRUNTIME_H
@@ -24,6 +24,9 @@
 					// execution stack, for detecting 
 					// stack overflows
 
+static int *stackCache[StackCacheSize];	// stacks of de-allocated threads,
+static int numCachedStacks = 0;		// ready for re-use
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -34,17 +37,24 @@
 
 Thread::Thread(char* threadName)
 {
-	int i;
-	for (i = 0; i < 10; i++) printf("%d ", !!(int)mask[i]); puts("");
-	for (i = 0; i < 128; i++) if (!mask[i]) {
-		mask[i] = this;
-		break;
-	}
-	threadId = i;
+    threadId = threadTable->Add(this);
+    priority = 0;
     name = threadName;
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    cpuTicks = 0;
+    userTicks = 0;
+    waitTicks = 0;
+    maxWait = 0;
+    lastSwitch = stats->totalTicks;
+    lastUserTicks = stats->userTicks;
+    blockedTicks = 0;
+    voluntarySwitches = involuntarySwitches = 0;
+    policyData = NULL;
+    wanted = 0;
+    donated = 0;
+    waitingFor = NULL;
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -60,16 +70,23 @@ Thread::Thread(char* threadName)
 //      NOTE: if this is the main thread, we can't delete the stack
 //      because we didn't allocate it -- we got it automatically
 //      as part of starting up Nachos.
+//
+//	Otherwise, the stack goes in the cache for the next thread to
+//	be forked, unless the cache is full.
 //----------------------------------------------------------------------
 
 Thread::~Thread()
 {
     DEBUG('t', "Deleting thread \"%s\"\n", name);
 
-	mask[threadId] = NULL;
     ASSERT(this != currentThread);
-    if (stack != NULL)
-	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    threadTable->Remove(threadId);
+    if (stack != NULL) {
+	if (numCachedStacks < StackCacheSize)
+	    stackCache[numCachedStacks++] = stack;
+	else
+	    DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    }
 }
 
 //----------------------------------------------------------------------
@@ -95,12 +112,6 @@ Thread::~Thread()
 void 
 Thread::Fork(VoidFunctionPtr func, int arg)
 {
-	int i = 0;
-	while (i < 128 && mask[i]) i++;
-	if (i == 128) {
-		DEBUG('t', "[Error] \"%s\" Thread limit exceed with func = 0x%x, arg = %d\n", name, (int) func, arg);
-		return;
-	}
     DEBUG('t', "Forking thread \"%s\" with func = 0x%x, arg = %d\n",
 	  name, (int) func, arg);
     
@@ -108,13 +119,10 @@ Thread::Fork(VoidFunctionPtr func, int arg)
 
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-	if (currentThread->priority < priority) {
-		scheduler->ReadyToRun(currentThread);
-		scheduler->Run(this);
-	} else {
-		scheduler->ReadyToRun(this);	// ReadyToRun assumes that interrupts 
+    scheduler->ReadyToRun(this);	// ReadyToRun assumes that interrupts 
 					// are disabled!
-	}
+    if (scheduler->ShouldPreempt(this))	// and run it now, if it's that
+	currentThread->Yield();		// important
 
     (void) interrupt->SetLevel(oldLevel);
 }    
@@ -167,7 +175,8 @@ Thread::Finish ()
     (void) interrupt->SetLevel(IntOff);		
     ASSERT(this == currentThread);
     
-    DEBUG('t', "Finishing thread \"%s\"\n", getName());
+    DEBUG('t', "Finishing thread \"%s\": ran %d ticks, waited %d "
+	  "(longest %d)\n", getName(), cpuTicks, waitTicks, maxWait);
     
     threadToBeDestroyed = currentThread;
     Sleep();					// invokes SWITCH
@@ -240,29 +249,75 @@ Thread::Sleep ()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
     status = BLOCKED;
-    while ((nextThread = scheduler->FindNextToRun()) == NULL)
+    while ((nextThread = scheduler->FindNextToRun()) == NULL) {
+#ifdef USER_PROGRAM
+	if (scheduler->IdleCPU())
+	    return;		// another CPU ran us again
+#endif
 	interrupt->Idle();	// no one to run, wait for an interrupt
+    }
         
     scheduler->Run(nextThread); // returns when we've been signalled
 }
 
 //----------------------------------------------------------------------
-// ThreadFinish, InterruptEnable, ThreadPrint
+// Thread::Print
+// 	Print a thread's time accounting, for debugging: how long it has
+//	run (in user code, and in the kernel), how long it has waited on
+//	the ready list and been blocked, how often it gave up the CPU, 
+//	and a histogram of how long it waited each time it was ready.
+//	If it is running, it hasn't been charged for the time since it
+//	started; count that too.
+//----------------------------------------------------------------------
+
+void
+Thread::Print()
+{
+    int ran = cpuTicks, user = userTicks;
+
+    if (status == RUNNING && stats->totalTicks > lastSwitch) {
+	ran += stats->totalTicks - lastSwitch;
+	user += stats->userTicks - lastUserTicks;
+    }
+    printf("thread id:%d, name: %s, ran %d (user %d, system %d), waited %d "
+	   "(longest %d), blocked %d, switches %d voluntary, %d involuntary\n",
+	   threadId, name, ran, user, ran - user, waitTicks, maxWait,
+	   blockedTicks, voluntarySwitches, involuntarySwitches);
+    if (readyLatency.Count() > 0) {
+	printf("\tready list latency:");
+	readyLatency.Print();
+    }
+}
+
+//----------------------------------------------------------------------
+// ThreadFinish, ThreadBegin, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
 //	function.  So in order to do this, we create a dummy C function
 //	(which we can pass a pointer to), that then simply calls the 
 //	member function.
+//
+//	A new thread doesn't return from SWITCH into Scheduler::Run, the
+//	way other threads do, so ThreadBegin has to finish Run's job 
+//	(Scheduler::FinishSwitch), including de-allocating the thread that 
+//	just finished, if there is one.  Otherwise, if that new thread 
+//	finishes too before Run gets the chance, the first one would never
+//	be de-allocated.
 //----------------------------------------------------------------------
 
 static void ThreadFinish()    { currentThread->Finish(); }
-static void InterruptEnable() { interrupt->Enable(); }
+static void ThreadBegin()
+{
+    scheduler->FinishSwitch();
+    interrupt->Enable();
+}
 void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 
 //----------------------------------------------------------------------
 // Thread::StackAllocate
-//	Allocate and initialize an execution stack.  The stack is
-//	initialized with an initial stack frame for ThreadRoot, which:
-//		enables interrupts
+//	Allocate and initialize an execution stack, or take one from the
+//	cache, if there is one.  The stack is initialized with an 
+//	initial stack frame for ThreadRoot, which:
+//		calls ThreadBegin, to enable interrupts
 //		calls (*func)(arg)
 //		calls Thread::Finish
 //
@@ -273,7 +328,10 @@ void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 void
 Thread::StackAllocate (VoidFunctionPtr func, int arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    if (numCachedStacks > 0)
+	stack = stackCache[--numCachedStacks];
+    else
+	stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
@@ -298,7 +356,7 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 #endif  // HOST_SNAKE
     
     machineState[PCState] = (int) ThreadRoot;
-    machineState[StartupPCState] = (int) InterruptEnable;
+    machineState[StartupPCState] = (int) ThreadBegin;
     machineState[InitialPCState] = (int) func;
     machineState[InitialArgState] = arg;
     machineState[WhenDonePCState] = (int) ThreadFinish;
@@ -314,13 +372,18 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 //	Note that a user program thread has *two* sets of CPU registers -- 
 //	one for its state while executing user code, one for its state 
 //	while executing kernel code.  This routine saves the former.
+//
+//	The scheduler only saves them once some other thread needs the
+//	registers they are in, and that may not be on the current CPU.
+//
+//	"cpu" is the CPU whose registers hold the thread's state.
 //----------------------------------------------------------------------
 
 void
-Thread::SaveUserState()
+Thread::SaveUserState(int cpu)
 {
     for (int i = 0; i < NumTotalRegs; i++)
-	userRegisters[i] = machine->ReadRegister(i);
+	userRegisters[i] = machine->ReadRegister(cpu, i);
 }
 
 //----------------------------------------------------------------------
@@ -39,6 +39,8 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "ilist.h"
+#include "stats.h"
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -55,10 +57,20 @@
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 #define StackSize	(4 * 1024)	// in words
 
+// When a thread is de-allocated, its stack is kept for the next thread
+// to be forked, rather than freed -- up to this many of them.
+#define StackCacheSize	32
+
+
+// Thread priorities run from 0 (the default) up to NumPriorities - 1;
+// the scheduler runs more important threads first.
+#define NumPriorities	32
 
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 
+class Lock;
+
 // external function, dummy routine whose sole job is to call Thread::Print
 extern void ThreadPrint(int arg);	 
 
@@ -83,7 +95,7 @@ class Thread {
 	int userId;
 	int threadId;
 
-	int priority; // 0 as default
+	int priority; // 0 as default; see also "donated"
   public:
     Thread(char* debugName);		// initialize a Thread 
     ~Thread(); 				// deallocate a Thread
@@ -103,17 +115,57 @@ class Thread {
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
     char* getName() { return (name); }
-    void Print() { printf("thread id:%d, name: %s\n", threadId, name); }
+    void Print();			// Print its time accounting
 
 	void setUserId(int id) { userId = id; }
 	int getUserId(void) { return userId; }
 
-	void setThreadId(int id) { threadId = id; }
 	int getThreadId(void) { return threadId; }
 
-	void setPriority(int p) { priority = p; }
-	int getPriority(void) { return priority; }
+	void setPriority(int p) { 
+	    ASSERT(p >= 0 && p < NumPriorities); 
+	    priority = p; 
+	}
+	int getPriority(void) {		// its own priority, or a higher one
+	    return (donated > priority) ? donated : priority;
+	}				// lent it by a thread waiting for
+					// a lock it holds
+
+    ListLink<Thread> link;		// for the ready list, or the queue
+					// of a semaphore it is waiting on
+
+    // time accounting, kept up to date by the scheduler
+    int cpuTicks;			// how long it has run,
+    int userTicks;			// and how much of that in user code
+    int waitTicks;			// how long it has been ready to run,
+					// but not running
+    int maxWait;			// the longest of those waits
+    int lastSwitch;			// when it last started or stopped 
+					// running (or became ready)
+    int lastUserTicks;			// stats->userTicks, when it last
+					// started or stopped running (or
+					// its CPU took its turn)
+    int blockedTicks;			// how long it has been blocked
+    int voluntarySwitches;		// how often it gave up the CPU to 
+					// wait for something,
+    int involuntarySwitches;		// and while still ready to run
+    Histogram readyLatency;		// how long it waited to run, each
+					// time it was ready
+    void *policyData;			// what the scheduling policy keeps
+					// about it; the policy allocates
+					// and de-allocates it
+
+    int wanted;				// how much it is waiting for, in
+					// Semaphore::P
+
+    // priority inheritance, kept up to date by Lock
+    int donated;			// the highest priority of any thread
+					// waiting for a lock it holds
+    Lock *waitingFor;			// the lock it is waiting for, if any
+    IList<Lock> contended;		// the locks it holds that other
+					// threads are waiting for
   private:
     // some of the private data for this class is listed above
     
@@ -135,7 +187,8 @@ class Thread {
     int userRegisters[NumTotalRegs];	// user-level CPU register state
 
   public:
-    void SaveUserState();		// save user-level register state
+    void SaveUserState(int cpu);	// save user-level register state,
+					// from the registers of "cpu"
     void RestoreUserState();		// restore user-level register state
 
     AddrSpace *space;			// User code this thread is running.
@@ -0,0 +1,135 @@
+// threadpool.cc
+//	Routines for a pool of kernel threads.  See threadpool.h.
+//
+//	As in synch.cc, we keep the lists consistent by disabling
+//	interrupts while we change them.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "threadpool.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// PoolWorker
+// 	Dummy function, because C++ does not allow a pointer to a member
+//	function; each thread of the pool starts here.
+//
+//	"arg" is the pool.
+//----------------------------------------------------------------------
+
+static void
+PoolWorker(int arg)
+{
+    ThreadPool *pool = (ThreadPool *) arg;
+
+    pool->Work();
+}
+
+//----------------------------------------------------------------------
+// ThreadPool::ThreadPool
+// 	Fork the threads of a pool.  They park until there is work for
+//	them.
+//
+//	"debugName" is an arbitrary name, useful for debugging; it is
+//		also the name of each thread.
+//	"numThreads" is how many threads the pool has.
+//----------------------------------------------------------------------
+
+ThreadPool::ThreadPool(char *debugName, int numThreads)
+{
+    Thread *t;
+
+    ASSERT(numThreads > 0);
+    name = debugName;
+    numWorkers = numThreads;
+    workReady = new Semaphore("work ready", 0);
+    finished = new Semaphore("pool finished", 0);
+    for (int i = 0; i < numWorkers; i++) {
+	t = new Thread(name);
+	t->Fork(PoolWorker, (int) this);
+    }
+}
+
+//----------------------------------------------------------------------
+// ThreadPool::~ThreadPool
+// 	Hand each thread one last work item, telling it to finish, and
+//	wait until they all have; then de-allocate the pool.  Since the
+//	queue is in order, they do all the work handed to them first.
+//
+//	Must not be called by a thread of the pool.
+//----------------------------------------------------------------------
+
+ThreadPool::~ThreadPool()
+{
+    WorkItem *item;
+    int i;
+
+    for (i = 0; i < numWorkers; i++)
+	Run(NULL, 0);
+    for (i = 0; i < numWorkers; i++)
+	finished->P();
+
+    while ((item = freeItems.Remove()) != NULL)
+	delete item;
+    delete workReady;
+    delete finished;
+}
+
+//----------------------------------------------------------------------
+// ThreadPool::Run
+// 	Put a piece of work on the end of the queue, and wake up a
+//	thread to do it.  Re-uses the item of some earlier work, if
+//	there is one.
+//
+//	"func" is the procedure for a thread to call
+//	"arg" is the argument to pass to it
+//----------------------------------------------------------------------
+
+void
+ThreadPool::Run(VoidFunctionPtr func, int arg)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    WorkItem *item = freeItems.Remove();
+
+    if (item == NULL)
+	item = new WorkItem;
+    item->func = func;
+    item->arg = arg;
+    queue.Append(item);
+    (void) interrupt->SetLevel(oldLevel);
+    workReady->V();
+}
+
+//----------------------------------------------------------------------
+// ThreadPool::Work
+// 	The loop each thread of the pool runs: wait for a piece of work,
+//	take it off the queue, and do it, until told to finish.
+//----------------------------------------------------------------------
+
+void
+ThreadPool::Work()
+{
+    WorkItem *item;
+    VoidFunctionPtr func;
+    int arg;
+    IntStatus oldLevel;
+
+    for (;;) {
+	workReady->P();				// park until there's work
+	oldLevel = interrupt->SetLevel(IntOff);
+	item = queue.Remove();
+	func = item->func;
+	arg = item->arg;
+	freeItems.Append(item);
+	(void) interrupt->SetLevel(oldLevel);
+	if (func == NULL)
+	    break;
+	DEBUG('t', "Pool \"%s\" running func = 0x%x, arg = %d\n",
+	      name, (int) func, arg);
+	(*func)(arg);
+    }
+    finished->V();
+}
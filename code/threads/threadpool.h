@@ -0,0 +1,64 @@
+// threadpool.h
+//	Data structures for a pool of kernel threads, which run short
+//	pieces of work handed to them, one after another.
+//
+//	Forking a thread for each piece of work costs a Thread, and a
+//	stack, and the thread has to be scheduled for the first time.
+//	A pool forks its threads once; between pieces of work, each one
+//	waits ("parks") on a semaphore, until there is more to do.
+//
+//	Usage:
+//		pool = new ThreadPool("workers", 4);
+//		pool->Run(func, arg);	// (*func)(arg), on one of them
+//		...
+//		delete pool;		// once they have all finished
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "copyright.h"
+#include "ilist.h"
+#include "synch.h"
+
+// A piece of work waiting for a thread in the pool: call (*func)(arg).
+// A NULL func tells the thread that picks it up to finish.
+
+class WorkItem {
+  public:
+    VoidFunctionPtr func;
+    int arg;
+    ListLink<WorkItem> link;	// for the queue of work to do, or the
+				// items free for re-use
+};
+
+// The following class defines a pool of threads.
+
+class ThreadPool {
+  public:
+    ThreadPool(char *debugName, int numThreads);
+				// Fork "numThreads" threads, and park them
+    ~ThreadPool();		// Wait for them to finish the work
+				// handed to them, then let them go
+
+    void Run(VoidFunctionPtr func, int arg);
+				// Have one of the threads call
+				// (*func)(arg), as soon as one is free
+
+    void Work();		// What each thread of the pool does;
+				// internal to the pool
+
+  private:
+    char *name;			// useful for debugging
+    int numWorkers;		// how many threads it has
+    IList<WorkItem> queue;	// work for the threads to do, in order
+    IList<WorkItem> freeItems;	// work items to re-use
+    Semaphore *workReady;	// how many items are on the queue;
+				// the threads park here
+    Semaphore *finished;	// signalled by each thread, as it finishes
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,154 @@
+// threadtable.cc
+//	Routines to keep track of all the threads, by ID.  See
+//	threadtable.h.
+//
+//	The table is changed whenever a thread is created or de-allocated,
+//	so callers must not be interrupted by another thread doing the
+//	same; as with the ready list, it is up to them to disable
+//	interrupts if need be.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "threadtable.h"
+
+//----------------------------------------------------------------------
+// ThreadTable::ThreadTable
+// 	Initialize an empty table, with all its IDs on the free list,
+//	in order, so that they are handed out 0, 1, 2, ...
+//----------------------------------------------------------------------
+
+ThreadTable::ThreadTable()
+{
+    threads = NULL;
+    nextFree = NULL;
+    firstFree = lastFree = -1;
+    tableSize = 0;
+    numThreads = 0;
+    Grow();
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::~ThreadTable
+// 	De-allocate the table.  The threads in it are not de-allocated.
+//----------------------------------------------------------------------
+
+ThreadTable::~ThreadTable()
+{
+    delete [] threads;
+    delete [] nextFree;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Add
+// 	Give a thread the ID at the front of the free list, making more
+//	IDs first if there are none left.
+//
+//	"thread" is the thread to add.
+//----------------------------------------------------------------------
+
+int
+ThreadTable::Add(Thread *thread)
+{
+    int id;
+
+    ASSERT(thread != NULL);
+    if (firstFree == -1)
+	Grow();
+    id = firstFree;
+    firstFree = nextFree[id];
+    if (firstFree == -1)
+	lastFree = -1;
+    threads[id] = thread;
+    numThreads++;
+    return id;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Remove
+// 	Put an ID back on the end of the free list.
+//
+//	"id" is the ID of a thread that is being de-allocated.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Remove(int id)
+{
+    ASSERT(Lookup(id) != NULL);
+    threads[id] = NULL;
+    nextFree[id] = -1;
+    if (lastFree == -1)
+	firstFree = id;
+    else
+	nextFree[lastFree] = id;
+    lastFree = id;
+    numThreads--;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Lookup
+// 	Return the thread with an ID, or NULL if there is none (including
+//	if "id" is out of range, so that it is safe to call with an
+//	ID passed in by a user program).
+//
+//	"id" is the ID to look up.
+//----------------------------------------------------------------------
+
+Thread *
+ThreadTable::Lookup(int id)
+{
+    if (id < 0 || id >= tableSize)
+	return NULL;
+    return threads[id];
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Mapcar
+// 	Apply a function to each thread in the table, in order of ID.
+//
+//	"func" is the procedure to apply; it is passed the thread.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Mapcar(VoidFunctionPtr func)
+{
+    for (int id = 0; id < tableSize; id++)
+	if (threads[id] != NULL)
+	    (*func)((int) threads[id]);
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Grow
+// 	Double the size of the table (or give it its first IDs), and put
+//	the new IDs on the end of the free list, in order.  Only called
+//	once every ID is in use, so that the copying is paid for by the
+//	Adds since the last time.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Grow()
+{
+    int newSize = (tableSize == 0) ? InitialThreadTableSize : tableSize * 2;
+    Thread **newThreads = new Thread *[newSize];
+    int *newNextFree = new int[newSize];
+    int id;
+
+    ASSERT(firstFree == -1);
+    for (id = 0; id < tableSize; id++) {
+	newThreads[id] = threads[id];
+	newNextFree[id] = -1;
+    }
+    for (; id < newSize; id++) {
+	newThreads[id] = NULL;
+	newNextFree[id] = (id + 1 < newSize) ? id + 1 : -1;
+    }
+    delete [] threads;
+    delete [] nextFree;
+    threads = newThreads;
+    nextFree = newNextFree;
+    firstFree = tableSize;
+    lastFree = newSize - 1;
+    tableSize = newSize;
+}
@@ -0,0 +1,62 @@
+// threadtable.h
+//	Data structures for the table of all the threads in the system,
+//	indexed by thread ID.
+//
+//	Each thread is given an ID when it is created, and gives it back
+//	when it is de-allocated.  The IDs not in use are kept on a list,
+//	in the order they were given back, so that handing one out or
+//	taking one back is O(1).  It also means an ID is re-used as late
+//	as possible -- so a thread that asks for another one by ID (as
+//	a Join system call would) is unlikely to get a newer thread
+//	that happens to have the same ID.
+//
+//	The table starts out small, and doubles in size whenever all
+//	of its IDs are in use; there is no limit on the number of threads,
+//	other than memory.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADTABLE_H
+#define THREADTABLE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class Thread;
+
+// How many IDs the table has room for, to begin with.
+#define InitialThreadTableSize	64
+
+// The following class defines the table of threads.
+
+class ThreadTable {
+  public:
+    ThreadTable();			// initialize an empty table
+    ~ThreadTable();			// de-allocate it
+
+    int Add(Thread *thread);		// Give "thread" an ID, and return it
+    void Remove(int id);		// Take an ID back, once its thread
+					// is gone
+    Thread *Lookup(int id);		// The thread with ID "id", or NULL
+					// if there is none
+
+    int NumThreads() { return numThreads; }
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to each thread,
+					// in order of ID
+
+  private:
+    Thread **threads;			// threads[id] is the thread with
+					// that ID, or NULL if it is free
+    int *nextFree;			// for a free ID, the one given back
+					// after it, or -1
+    int firstFree;			// the free IDs, first to be handed
+    int lastFree;			// out to last; -1 if there are none
+    int tableSize;			// how many IDs there are
+    int numThreads;			// how many are in use
+
+    void Grow();			// Double the number of IDs
+};
+
+#endif // THREADTABLE_H
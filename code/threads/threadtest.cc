@@ -11,6 +11,12 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "list.h"
+#include "synch.h"
+#include "synchlist.h"
+#include "channel.h"
+#include "threadpool.h"
+#include "taskruntime.h"
 
 // testnum is set in main.cc
 int testnum = 1;
@@ -56,6 +62,952 @@ ThreadTest1()
     SimpleThread(0);
 }
 
+//----------------------------------------------------------------------
+// EventBenchmark
+// 	Time the interrupt simulation's event queue.  Keep a population
+//	of pending interrupts, each of which schedules another when it 
+//	fires, some of them cancelling a random other one as well, and 
+//	run the clock until a few million have fired.
+//----------------------------------------------------------------------
+
+#define BenchEvents	1000		// interrupts pending at once
+#define BenchFires	2000000		// how many to fire in all
+
+static PendingInterrupt *benchPending[BenchEvents];
+static int benchFired, benchCancelled;
+
+static void
+BenchHandler(int which)
+{
+    int victim;
+
+    benchFired++;
+    benchPending[which] = NULL;
+    if (benchFired >= BenchFires)
+	return;
+    if ((benchFired % 4) == 0) {	// cancel someone, and replace them
+	victim = Random() % BenchEvents;
+	if (benchPending[victim] != NULL) {
+	    ASSERT(interrupt->Cancel(benchPending[victim]));
+	    benchCancelled++;
+	    benchPending[victim] = interrupt->Schedule(BenchHandler, victim,
+					1 + Random() % 1000, TimerInt);
+	}
+    }
+    benchPending[which] = interrupt->Schedule(BenchHandler, which, 
+					1 + Random() % 1000, TimerInt);
+}
+
+void
+EventBenchmark()
+{
+    double start;
+    int i;
+
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    for (i = 0; i < BenchEvents; i++)
+	benchPending[i] = interrupt->Schedule(BenchHandler, i, 
+					1 + Random() % 1000, TimerInt);
+    start = HostTime();
+    while (benchFired < BenchFires) {
+	(void) interrupt->SetLevel(IntOn);	// advances the clock, and
+	(void) interrupt->SetLevel(IntOff);	// fires whatever is due
+    }
+    for (i = 0; i < BenchEvents; i++)
+	if (benchPending[i] != NULL)
+	    ASSERT(interrupt->Cancel(benchPending[i]));
+    printf("%d interrupts fired, %d cancelled, %d pending: %.3f seconds, "
+	   "%.0f per second\n", benchFired, benchCancelled, BenchEvents, 
+	   HostTime() - start, benchFired / (HostTime() - start));
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SwitchBenchmark
+// 	Time context switches, with more and more threads ready to run.
+//	Each thread yields until the switches run out; half of them
+//	at a higher priority, so that the ready list is not just one
+//	queue.
+//----------------------------------------------------------------------
+
+#define BenchSwitches	200000		// context switches to time, for
+					// each number of threads
+
+static int benchYields, benchRunning;
+
+static void
+YieldThread(int dummy)
+{
+    while (benchYields > 0) {
+	benchYields--;
+	currentThread->Yield();
+    }
+    benchRunning--;
+}
+
+void
+SwitchBenchmark()
+{
+    static int sizes[] = { 10, 100, 1000, 10000 };
+    double start, elapsed;
+    Thread *t;
+    int i, n;
+
+    for (i = 0; i < 4; i++) {
+	n = sizes[i];
+	benchYields = BenchSwitches;
+	benchRunning = n;
+	currentThread->setPriority(2);	// so that neither Fork nor the 
+	for (int j = 0; j < n; j++) {	// timer switches to them yet
+	    t = new Thread("yield thread");
+	    t->setPriority(j % 2);
+	    t->Fork(YieldThread, j);
+	}
+	currentThread->setPriority(0);	// wait for them at the lowest
+	start = HostTime();		// priority, out of the way
+	while (benchRunning > 0)
+	    currentThread->Yield();
+	elapsed = HostTime() - start;
+	printf("%d threads: %d switches, %.3f seconds, %.0f per second\n",
+	       n, BenchSwitches, elapsed, BenchSwitches / elapsed);
+    }
+}
+
+//----------------------------------------------------------------------
+// ListBenchmark
+// 	Compare the old List with the intrusive IList, for the way the
+//	kernel uses its queues: items go on the end, and come off the
+//	front.  Count how many ListElements the List allocates, and time
+//	them both.
+//----------------------------------------------------------------------
+
+#define BenchItems	1000		// items on the queue at once
+#define BenchMoves	2000000		// how many to take off and put back
+
+class BenchItem {
+  public:
+    int value;
+    ListLink<BenchItem> link;
+};
+
+void
+ListBenchmark()
+{
+    BenchItem *items = new BenchItem[BenchItems];
+    List *list = new List;
+    IList<BenchItem> ilist;
+    BenchItem *item;
+    int i, sum, created;
+    double start, elapsed;
+
+    for (i = 0; i < BenchItems; i++)
+	items[i].value = i;
+
+    created = ListElement::numCreated;
+    start = HostTime();
+    for (i = 0; i < BenchItems; i++)
+	list->Append((void *) &items[i]);
+    for (i = 0, sum = 0; i < BenchMoves; i++) {
+	item = (BenchItem *) list->Remove();
+	sum += item->value;
+	list->Append((void *) item);
+    }
+    while (!list->IsEmpty())
+	(void) list->Remove();
+    elapsed = HostTime() - start;
+    printf("List:  %d moves, %d allocations, %.3f seconds, %.0f per second"
+	   " (sum %d)\n", BenchMoves, ListElement::numCreated - created,
+	   elapsed, BenchMoves / elapsed, sum);
+
+    created = ListElement::numCreated;
+    start = HostTime();
+    for (i = 0; i < BenchItems; i++)
+	ilist.Append(&items[i]);
+    for (i = 0, sum = 0; i < BenchMoves; i++) {
+	item = ilist.Remove();
+	sum += item->value;
+	ilist.Append(item);
+    }
+    while (!ilist.IsEmpty())
+	(void) ilist.Remove();
+    elapsed = HostTime() - start;
+    printf("IList: %d moves, %d allocations, %.3f seconds, %.0f per second"
+	   " (sum %d)\n", BenchMoves, ListElement::numCreated - created,
+	   elapsed, BenchMoves / elapsed, sum);
+
+    delete list;
+    delete [] items;
+}
+
+//----------------------------------------------------------------------
+// InteractiveBenchmark
+// 	Run an "interactive" thread, which only wants the CPU for a
+//	moment at a time, against a few CPU-bound "hogs" of higher
+//	priority, and report how long each waited to run.  Under strict
+//	priority (-sched priority), the interactive thread waits until
+//	the hogs are done; under -sched fair, it gets its share.
+//----------------------------------------------------------------------
+
+#define BenchHogs	4		// CPU-bound threads
+#define HogBursts	200		// each runs this many bursts,
+#define BurstTicks	200		// of this many ticks, yielding after
+					// each one
+#define InteractiveRounds 100		// the interactive thread's bursts
+
+static void
+Burn(int ticks)
+{
+    for (int i = 0; i < ticks; i += SystemTick) {
+	(void) interrupt->SetLevel(IntOff);	// the clock advances when
+	(void) interrupt->SetLevel(IntOn);	// interrupts are enabled
+    }
+}
+
+static void
+BenchReport(char *what)
+{
+    int ran = stats->totalTicks - currentThread->lastSwitch; // not yet
+							     // charged for
+
+    printf("%s: ran %d, waited %d (longest %d), done at %d\n", what,
+	   currentThread->cpuTicks + ran, currentThread->waitTicks,
+	   currentThread->maxWait, stats->totalTicks);
+}
+
+static void
+HogThread(int which)
+{
+    for (int i = 0; i < HogBursts; i++) {
+	Burn(BurstTicks);
+	currentThread->Yield();
+    }
+    BenchReport("hog");
+    benchRunning--;
+}
+
+static void
+InteractiveThread(int dummy)
+{
+    for (int i = 0; i < InteractiveRounds; i++) {
+	Burn(SystemTick);
+	currentThread->Yield();
+    }
+    BenchReport("interactive");
+    benchRunning--;
+}
+
+void
+InteractiveBenchmark()
+{
+    Thread *t;
+
+    benchRunning = BenchHogs + 1;
+    currentThread->setPriority(1);	// so that Fork doesn't switch to
+    for (int i = 0; i < BenchHogs; i++) {	// the new threads yet
+	t = new Thread("hog");
+	t->setPriority(1);
+	t->Fork(HogThread, i);
+    }
+    t = new Thread("interactive");
+    t->Fork(InteractiveThread, 0);
+    currentThread->setPriority(0);
+    while (benchRunning > 0)
+	currentThread->Yield();
+}
+
+//----------------------------------------------------------------------
+// ResponseBenchmark
+// 	Run a few "typists" -- threads that wait for a keystroke, and
+//	then handle it in a moment -- against CPU-bound hogs that never
+//	give up the CPU of their own accord, and report percentiles of
+//	the response time: from each keystroke until its typist runs.
+//	Under -sched priority, the typists take their turns with the
+//	hogs; under -sched mlfq, the hogs soon sink below them.
+//----------------------------------------------------------------------
+
+#define ResponseHogs	4		// CPU-bound threads,
+#define HogTicks	20000		// each running this long
+#define Typists		2		// interactive threads,
+#define Keystrokes	50		// each handling this many keys,
+#define KeyTicks	20		// in this long,
+#define ThinkTicks	500		// this long apart
+
+static Semaphore *keyPressed[Typists];	// signalled by each keystroke
+static int keyTime[Typists][Keystrokes]; // when each key was pressed
+static int keysPressed[Typists];	// how many keys have been pressed
+static int responses[Typists * Keystrokes]; // each response time
+static int numResponses;
+static Semaphore *benchDone;		// signalled by each thread, as
+					// it finishes
+
+// The user presses a key every ThinkTicks, whether or not the typist 
+// has got round to the last one; this stands in for the console.
+
+static void
+KeyHandler(int which)
+{
+    keyTime[which][keysPressed[which]++] = stats->totalTicks;
+    if (keysPressed[which] < Keystrokes)
+	interrupt->Schedule(KeyHandler, which, ThinkTicks, ConsoleReadInt);
+    keyPressed[which]->V();
+}
+
+static void
+TypistThread(int which)
+{
+    for (int i = 0; i < Keystrokes; i++) {
+	keyPressed[which]->P();
+	responses[numResponses++] = stats->totalTicks - keyTime[which][i];
+	Burn(KeyTicks);
+    }
+    BenchReport("typist");
+    benchDone->V();
+}
+
+static void
+SpinThread(int which)
+{
+    Burn(HogTicks);
+    BenchReport("hog");
+    benchDone->V();
+}
+
+static int
+Percentile(int pct)
+{
+    int i = numResponses * pct / 100;
+
+    return responses[i < numResponses ? i : numResponses - 1];
+}
+
+void
+ResponseBenchmark()
+{
+    Thread *t;
+    int i, j, r;
+
+    benchDone = new Semaphore("bench done", 0);
+    numResponses = 0;
+    for (i = 0; i < ResponseHogs; i++) {
+	t = new Thread("hog");
+	t->Fork(SpinThread, i);
+    }
+    for (i = 0; i < Typists; i++) {
+	keyPressed[i] = new Semaphore("key pressed", 0);
+	keysPressed[i] = 0;
+	interrupt->Schedule(KeyHandler, i, ThinkTicks, ConsoleReadInt);
+	t = new Thread("typist");
+	t->Fork(TypistThread, i);
+    }
+    for (i = 0; i < ResponseHogs + Typists; i++)
+	benchDone->P();
+
+    for (i = 1; i < numResponses; i++) {	// sort the response times
+	r = responses[i];
+	for (j = i; j > 0 && responses[j - 1] > r; j--)
+	    responses[j] = responses[j - 1];
+	responses[j] = r;
+    }
+    printf("%d responses: 50%% within %d ticks, 90%% %d, 99%% %d, "
+	   "all %d\n", numResponses, Percentile(50), Percentile(90),
+	   Percentile(99), responses[numResponses - 1]);
+
+    for (i = 0; i < Typists; i++)
+	delete keyPressed[i];
+    delete benchDone;
+}
+
+//----------------------------------------------------------------------
+// ForkBenchmark
+// 	Time how long it takes to get a short piece of work done on
+//	another thread: by forking a thread for it, which then finishes,
+//	or by handing it to a thread pool.  Either way, we yield the CPU
+//	to let it run.
+//----------------------------------------------------------------------
+
+#define BenchForks	100000		// pieces of work to time
+#define BenchPoolSize	4		// threads in the pool
+
+static int benchWorkDone;
+
+static void
+BenchWork(int dummy)
+{
+    benchWorkDone++;
+}
+
+void
+ForkBenchmark()
+{
+    ThreadPool *pool;
+    Thread *t;
+    double start, elapsed;
+
+    benchWorkDone = 0;
+    start = HostTime();
+    for (int i = 0; i < BenchForks; i++) {
+	t = new Thread("forked");
+	t->Fork(BenchWork, i);
+	currentThread->Yield();
+    }
+    elapsed = HostTime() - start;
+    ASSERT(benchWorkDone == BenchForks);
+    printf("fork and finish: %d in %.3f seconds, %.0f per second\n", 
+	   BenchForks, elapsed, BenchForks / elapsed);
+
+    benchWorkDone = 0;
+    pool = new ThreadPool("bench pool", BenchPoolSize);
+    start = HostTime();
+    for (int i = 0; i < BenchForks; i++) {
+	pool->Run(BenchWork, i);
+	currentThread->Yield();
+    }
+    delete pool;
+    elapsed = HostTime() - start;
+    ASSERT(benchWorkDone == BenchForks);
+    printf("thread pool: %d in %.3f seconds, %.0f per second\n", 
+	   BenchForks, elapsed, BenchForks / elapsed);
+}
+
+//----------------------------------------------------------------------
+// LockBenchmark
+// 	Time Lock::Acquire and Release: first with no one else after the
+//	lock, and then with a few threads taking turns with it, each 
+//	giving up the CPU while it holds the lock, so that the others 
+//	have to wait for it.  Report how long they waited, in ticks.
+//
+//	Then set up a priority inversion: a low-priority thread holds a
+//	lock that a high-priority thread wants, while a CPU hog of middle
+//	priority is ready to run.  Without priority inheritance, the
+//	high-priority thread would wait until the hog was done; with it,
+//	only for as long as the lock is held (or, under policies that 
+//	give the hog a share of the CPU anyway, a few times that).  The
+//	benchmark fails if it waits much longer.
+//----------------------------------------------------------------------
+
+#define BenchAcquires	1000000		// uncontended acquisitions to time
+#define LockThreads	4		// threads contending for the lock,
+#define LockRounds	25000		// each acquiring it this often
+#define HoldTicks	1000		// how long the low-priority thread
+					// holds the lock
+
+static Lock *benchLock;
+static int lockWaited, lockMaxWait;	// how long threads waited for it
+
+static void
+LockThread(int which)
+{
+    int start, waited;
+
+    for (int i = 0; i < LockRounds; i++) {
+	start = stats->totalTicks;
+	benchLock->Acquire();
+	waited = stats->totalTicks - start;
+	lockWaited += waited;
+	if (waited > lockMaxWait)
+	    lockMaxWait = waited;
+	currentThread->Yield();		// still holding the lock
+	benchLock->Release();
+    }
+    benchDone->V();
+}
+
+static void
+ImportantThread(int dummy)
+{
+    int start = stats->totalTicks, waited;
+
+    benchLock->Acquire();
+    waited = stats->totalTicks - start;
+    printf("priority inversion: high-priority thread waited %d ticks "
+	   "for the lock\n", waited);
+    ASSERT(waited >= HoldTicks);	// it was held all that time, but
+    ASSERT(waited < 4 * HoldTicks);	// the hog didn't get in first
+    benchLock->Release();
+    benchDone->V();
+}
+
+static void
+UnimportantThread(int dummy)
+{
+    Thread *t;
+
+    benchLock->Acquire();
+    t = new Thread("important");	// runs at once, and waits for 
+    t->setPriority(2);			// the lock
+    t->Fork(ImportantThread, 0);
+    t = new Thread("hog");		// would take the CPU from us, if 
+    t->setPriority(1);			// we weren't lent priority 2
+    t->Fork(SpinThread, 0);
+    Burn(HoldTicks);
+    benchLock->Release();
+    benchDone->V();
+}
+
+void
+LockBenchmark()
+{
+    double start, elapsed;
+    Thread *t;
+    int i, acquires;
+
+    benchLock = new Lock("bench lock");
+    benchDone = new Semaphore("bench done", 0);
+
+    start = HostTime();
+    for (i = 0; i < BenchAcquires; i++) {
+	benchLock->Acquire();
+	benchLock->Release();
+    }
+    elapsed = HostTime() - start;
+    printf("uncontended: %d acquisitions in %.3f seconds, %.0f per "
+	   "second\n", BenchAcquires, elapsed, BenchAcquires / elapsed);
+
+    lockWaited = lockMaxWait = 0;
+    acquires = LockThreads * LockRounds;
+    start = HostTime();
+    for (i = 0; i < LockThreads; i++) {
+	t = new Thread("lock thread");
+	t->Fork(LockThread, i);
+    }
+    for (i = 0; i < LockThreads; i++)
+	benchDone->P();
+    elapsed = HostTime() - start;
+    printf("%d threads: %d acquisitions in %.3f seconds, %.0f per second, "
+	   "waited %d ticks on average (longest %d)\n", LockThreads, 
+	   acquires, elapsed, acquires / elapsed, lockWaited / acquires, 
+	   lockMaxWait);
+
+    t = new Thread("unimportant");
+    t->Fork(UnimportantThread, 0);
+    for (i = 0; i < 3; i++)
+	benchDone->P();
+
+    delete benchLock;
+    delete benchDone;
+}
+
+//----------------------------------------------------------------------
+// RWLockBenchmark
+// 	Have a few readers and a writer share a table, first protected
+//	by a Lock, then by an RWLock.  Each holds it while it waits for
+//	the disk.  With the Lock, the readers have to take turns; with
+//	the RWLock, they wait for the disk at once.  Then print the lock
+//	statistics, to show where the time went.
+//----------------------------------------------------------------------
+
+#define TableReaders	4		// threads reading the table,
+#define TableReads	5000		// each this often
+#define TableWrites	500		// how often the writer writes it
+#define DiskTicks	100		// how long each waits for the disk
+#define WriterThinks	1000		// and the writer, between writes
+
+static RWLock *tableRWLock;		// if NULL, use benchLock
+static Semaphore *diskDone[TableReaders + 1]; // for each thread
+
+static void
+DiskHandler(int which)
+{
+    diskDone[which]->V();
+}
+
+static void
+WaitForDisk(int which, int ticks)
+{
+    interrupt->Schedule(DiskHandler, which, ticks, DiskInt);
+    diskDone[which]->P();
+}
+
+static void
+TableReader(int which)
+{
+    for (int i = 0; i < TableReads; i++) {
+	if (tableRWLock != NULL)
+	    tableRWLock->AcquireRead();
+	else
+	    benchLock->Acquire();
+	WaitForDisk(which, DiskTicks);
+	if (tableRWLock != NULL)
+	    tableRWLock->ReleaseRead();
+	else
+	    benchLock->Release();
+    }
+    benchDone->V();
+}
+
+static void
+TableWriter(int which)
+{
+    for (int i = 0; i < TableWrites; i++) {
+	if (tableRWLock != NULL)
+	    tableRWLock->AcquireWrite();
+	else
+	    benchLock->Acquire();
+	WaitForDisk(which, DiskTicks);
+	if (tableRWLock != NULL)
+	    tableRWLock->ReleaseWrite();
+	else
+	    benchLock->Release();
+	WaitForDisk(which, WriterThinks);
+    }
+    benchDone->V();
+}
+
+static void
+TableBenchmark(char *what)
+{
+    int i, start = stats->totalTicks;
+    Thread *t;
+
+    for (i = 0; i < TableReaders; i++) {
+	t = new Thread("table reader");
+	t->Fork(TableReader, i);
+    }
+    t = new Thread("table writer");
+    t->Fork(TableWriter, TableReaders);
+    for (i = 0; i < TableReaders + 1; i++)
+	benchDone->P();
+    printf("%s: %d reads and %d writes in %d ticks\n", what, 
+	   TableReaders * TableReads, TableWrites, stats->totalTicks - start);
+}
+
+void
+RWLockBenchmark()
+{
+    int i;
+
+    benchDone = new Semaphore("bench done", 0);
+    for (i = 0; i < TableReaders + 1; i++)
+	diskDone[i] = new Semaphore("disk done", 0);
+
+    benchLock = new Lock("table Lock");
+    tableRWLock = NULL;
+    TableBenchmark("Lock");
+    tableRWLock = new RWLock("table RWLock");
+    TableBenchmark("RWLock");
+    PrintLockStats();
+
+    for (i = 0; i < TableReaders + 1; i++)
+	delete diskDone[i];
+    delete tableRWLock;
+    delete benchLock;
+    delete benchDone;
+}
+
+//----------------------------------------------------------------------
+// SemaphoreTest
+// 	Have a few threads take turns with a semaphore, one at a time,
+//	while another wants all of it at once, with P(3).  Each of the
+//	small ones yields while it holds its share, and again once it
+//	has given it back, so at almost any moment one of them holds a
+//	share; if new P(1)s could go ahead of a waiting P(3), it would
+//	wait until the others were all done.  Print how many P(1)s it
+//	waited for.
+//----------------------------------------------------------------------
+
+#define SmallTakers	3		// threads taking 1 at a time,
+#define SmallTakes	1000		// each this often
+
+static Semaphore *shared;		// the semaphore they share
+static int smallTaken;			// how many P(1)s have returned
+static int bigTakenAt;			// how many had, when P(3) did
+
+static void
+SmallTaker(int which)
+{
+    for (int i = 0; i < SmallTakes; i++) {
+	shared->P();
+	smallTaken++;
+	currentThread->Yield();
+	shared->V();
+	currentThread->Yield();
+    }
+    benchDone->V();
+}
+
+static void
+BigTaker(int which)
+{
+    shared->P(SmallTakers);
+    bigTakenAt = smallTaken;
+    shared->V(SmallTakers);
+    benchDone->V();
+}
+
+void
+SemaphoreTest()
+{
+    Thread *t;
+    int i;
+
+    benchDone = new Semaphore("bench done", 0);
+    shared = new Semaphore("shared", SmallTakers);
+    smallTaken = 0;
+    for (i = 0; i < SmallTakers; i++) {
+	t = new Thread("small taker");
+	t->Fork(SmallTaker, i);
+    }
+    t = new Thread("big taker");
+    t->Fork(BigTaker, SmallTakers);
+    for (i = 0; i < SmallTakers + 1; i++)
+	benchDone->P();
+    printf("P(%d) returned after %d of %d P(1)s\n", SmallTakers, bigTakenAt,
+	   SmallTakers * SmallTakes);
+    ASSERT(bigTakenAt < SmallTakers * SmallTakes);
+
+    delete shared;
+    delete benchDone;
+}
+
+//----------------------------------------------------------------------
+// ChannelBenchmark
+// 	Pass items from a producer thread to a consumer thread, which
+//	yield to each other whenever they can, and count the context
+//	switches it takes: with a SynchList, and with a Channel taking
+//	one item at a time, the consumer is woken up for each item;
+//	with a Channel taking them in batches, only for each batch.
+//----------------------------------------------------------------------
+
+#define ChannelItems	100000		// items to pass
+#define ChannelSize	64		// how many the channel holds
+#define ChannelBatch	16		// how many the consumer takes at once
+
+static BenchItem *channelItems;
+static SynchList<BenchItem> *benchList;	// if NULL, use benchChannel
+static Channel<BenchItem> *benchChannel;
+static int channelBatch;		// how many to wait for, at once
+static int channelSum;			// of the items received,
+static int channelExpected;		// and of the items sent
+
+static void
+Producer(int dummy)
+{
+    for (int i = 0; i < ChannelItems; i++) {
+	if (benchList != NULL)
+	    benchList->Append(&channelItems[i]);
+	else
+	    benchChannel->Send(&channelItems[i]);
+	currentThread->Yield();
+    }
+    benchDone->V();
+}
+
+static void
+Consumer(int dummy)
+{
+    BenchItem *batch[ChannelBatch];
+    int received = 0, want, n;
+
+    while (received < ChannelItems) {
+	if (benchList != NULL) {
+	    batch[0] = benchList->Remove();
+	    n = 1;
+	} else {
+	    want = ChannelItems - received;
+	    if (want > channelBatch)
+		want = channelBatch;
+	    n = benchChannel->ReceiveBatch(batch, want, channelBatch);
+	}
+	for (int i = 0; i < n; i++)
+	    channelSum += batch[i]->value;
+	received += n;
+    }
+    benchDone->V();
+}
+
+static void
+ChannelRun(char *what)
+{
+    int switches = stats->numContextSwitches;
+    double start = HostTime();
+    Thread *t;
+
+    channelSum = 0;
+    t = new Thread("consumer");		// first, so that it is waiting
+    t->Fork(Consumer, 0);
+    t = new Thread("producer");
+    t->Fork(Producer, 0);
+    benchDone->P();
+    benchDone->P();
+    switches = stats->numContextSwitches - switches;
+    printf("%s: %d items, %d switches, %.2f per item, %.3f seconds"
+	   " (sum %d)\n", what, ChannelItems, switches,
+	   (double) switches / ChannelItems, HostTime() - start, channelSum);
+    ASSERT(channelSum == channelExpected);	// none lost or repeated
+}
+
+void
+ChannelBenchmark()
+{
+    channelItems = new BenchItem[ChannelItems];
+    channelExpected = 0;
+    for (int i = 0; i < ChannelItems; i++) {
+	channelItems[i].value = i % 1000;
+	channelExpected += channelItems[i].value;
+    }
+    benchDone = new Semaphore("bench done", 0);
+
+    benchList = new SynchList<BenchItem>;
+    ChannelRun("SynchList");
+    delete benchList;
+    benchList = NULL;
+
+    benchChannel = new Channel<BenchItem>("bench channel", ChannelSize);
+    channelBatch = 1;
+    ChannelRun("Channel, one at a time");
+    channelBatch = ChannelBatch;
+    ChannelRun("Channel, in batches");
+    delete benchChannel;
+
+    delete benchDone;
+    delete [] channelItems;
+}
+
+//----------------------------------------------------------------------
+// TaskBenchmark
+// 	Checksum a lot of disk sectors (from memory), one piece of work
+//	each: with a thread forked for each, with a thread pool, and with
+//	tasks, in a ParallelFor.  Then compute a Fibonacci number the
+//	slow way, with a task for each call, to time spawn and sync.
+//----------------------------------------------------------------------
+
+#define TaskSectors	100000		// sectors to checksum
+#define TaskDiskSize	256		// sectors of data to checksum over
+#define TaskSectorSize	128		// bytes in each
+#define TaskWorkers	4		// workers (and threads in the pool)
+#define TaskFib		20		// the Fibonacci number to compute
+
+static TaskRuntime *benchRuntime;
+static unsigned char *taskDisk;
+static unsigned int taskSum;
+static unsigned int taskExpected;	// taskSum, when done one by one
+static Semaphore *taskDone;
+
+static void
+ChecksumSector(int sector)
+{
+    unsigned char *data = &taskDisk[(sector % TaskDiskSize) * TaskSectorSize];
+    unsigned int sum = 0;
+
+    for (int i = 0; i < TaskSectorSize; i++)
+	sum = (sum << 1 | sum >> 31) ^ data[i];
+    taskSum += sum;
+}
+
+static void
+ChecksumAndSignal(int sector)
+{
+    ChecksumSector(sector);
+    taskDone->V();
+}
+
+static void
+TaskReport(char *what, double start, int switches)
+{
+    double elapsed = HostTime() - start;
+
+    printf("%s: %d sectors in %.3f seconds, %.0f ns each, %d switches"
+	   " (sum %u)\n", what, TaskSectors, elapsed,
+	   elapsed * 1e9 / TaskSectors, stats->numContextSwitches - switches,
+	   taskSum);
+    ASSERT(taskSum == taskExpected);	// each sector done exactly once
+}
+
+class FibCall {
+  public:
+    int n;
+    int result;
+};
+
+static void
+FibTask(int arg)
+{
+    FibCall *call = (FibCall *) arg;
+    FibCall a, b;
+    TaskGroup group;
+
+    if (call->n < 2) {
+	call->result = call->n;
+	return;
+    }
+    a.n = call->n - 1;
+    b.n = call->n - 2;
+    benchRuntime->Spawn(&group, FibTask, (int) &a);
+    FibTask((int) &b);
+    benchRuntime->Sync(&group);
+    call->result = a.result + b.result;
+}
+
+void
+TaskBenchmark()
+{
+    ThreadPool *pool;
+    Thread *t;
+    FibCall *call = new FibCall;
+    TaskGroup group;
+    double start;
+    int i, switches;
+
+    taskDisk = new unsigned char[TaskDiskSize * TaskSectorSize];
+    for (i = 0; i < TaskDiskSize * TaskSectorSize; i++)
+	taskDisk[i] = (i * 7 + i / TaskSectorSize) & 0xff;
+    taskDone = new Semaphore("task done", 0);
+
+    taskSum = 0;
+    for (i = 0; i < TaskSectors; i++)
+	ChecksumSector(i);
+    taskExpected = taskSum;
+
+    taskSum = 0;
+    switches = stats->numContextSwitches;
+    start = HostTime();
+    for (i = 0; i < TaskSectors; i++) {
+	t = new Thread("checksum");
+	t->Fork(ChecksumSector, i);
+	currentThread->Yield();
+    }
+    TaskReport("thread each", start, switches);
+
+    taskSum = 0;
+    pool = new ThreadPool("checksum pool", TaskWorkers);
+    switches = stats->numContextSwitches;
+    start = HostTime();
+    for (i = 0; i < TaskSectors; i++)
+	pool->Run(ChecksumAndSignal, i);
+    taskDone->P(TaskSectors);
+    TaskReport("thread pool", start, switches);
+    delete pool;
+
+    benchRuntime = new TaskRuntime("checksum tasks", TaskWorkers);
+    taskSum = 0;
+    switches = stats->numContextSwitches;
+    start = HostTime();
+    benchRuntime->ParallelFor(0, TaskSectors, 1, ChecksumSector);
+    TaskReport("tasks, one each", start, switches);
+    taskSum = 0;
+    switches = stats->numContextSwitches;
+    start = HostTime();
+    benchRuntime->ParallelFor(0, TaskSectors, 64, ChecksumSector);
+    TaskReport("tasks, 64 each", start, switches);
+    benchRuntime->Print();
+
+    call->n = TaskFib;
+    switches = stats->numContextSwitches;
+    start = HostTime();
+    benchRuntime->Spawn(&group, FibTask, (int) call);
+    benchRuntime->Sync(&group);
+    printf("fib(%d) = %d: %.3f seconds, %d switches\n", TaskFib, 
+	   call->result, HostTime() - start, 
+	   stats->numContextSwitches - switches);
+    ASSERT(call->result == 6765);	// fib(20)
+    benchRuntime->Print();
+    delete benchRuntime;
+    delete call;
+
+    delete taskDone;
+    delete [] taskDisk;
+}
+
 //----------------------------------------------------------------------
 // ThreadTest
 // 	Invoke a test routine.
@@ -68,6 +1020,39 @@ ThreadTest()
     case 1:
 	ThreadTest1();
 	break;
+    case 2:
+	EventBenchmark();
+	break;
+    case 3:
+	SwitchBenchmark();
+	break;
+    case 4:
+	ListBenchmark();
+	break;
+    case 5:
+	InteractiveBenchmark();
+	break;
+    case 6:
+	ResponseBenchmark();
+	break;
+    case 7:
+	ForkBenchmark();
+	break;
+    case 8:
+	LockBenchmark();
+	break;
+    case 9:
+	RWLockBenchmark();
+	break;
+    case 10:
+	ChannelBenchmark();
+	break;
+    case 11:
+	TaskBenchmark();
+	break;
+    case 12:
+	SemaphoreTest();
+	break;
     default:
 	printf("No test specified.\n");
 	break;
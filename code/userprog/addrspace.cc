@@ -54,8 +54,12 @@ SwapHeader (NoffHeader *noffH)
 //	Assumes that the object code file is in NOFF format.
 //
 //	First, set up the translation from program memory to physical 
-//	memory.  For now, this is really simple (1:1), since we are
-//	only uniprogramming, and we have a single unsegmented page table
+//	memory: a single unsegmented page table, with each virtual page
+//	in a page frame taken from frameMap, wherever there is one free.
+//	So several programs can be in memory at once.  Then zero the
+//	frames (the uninitialized data and the stack must start out
+//	zero, and we mustn't leave the last owner's data in them), and
+//	load the code and data into them, a page at a time.
 //
 //	"executable" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
@@ -78,18 +82,18 @@ AddrSpace::AddrSpace(OpenFile *executable)
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
 
-    ASSERT(numPages <= NumPhysPages);		// check we're not trying
-						// to run anything too big --
-						// at least until we have
-						// virtual memory
+    ASSERT(numPages <= (unsigned int) frameMap->NumClear());
+						// check there is room for
+						// it -- at least until we
+						// have virtual memory
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
 					numPages, size);
 // first, set up the translation 
     pageTable = new TranslationEntry[numPages];
     for (i = 0; i < numPages; i++) {
-	pageTable[i].virtualPage = i;	// for now, virtual page # = phys page #
-	pageTable[i].physicalPage = i;
+	pageTable[i].virtualPage = i;
+	pageTable[i].physicalPage = frameMap->Find();
 	pageTable[i].valid = TRUE;
 	pageTable[i].use = FALSE;
 	pageTable[i].dirty = FALSE;
@@ -98,34 +102,78 @@ AddrSpace::AddrSpace(OpenFile *executable)
 					// pages to be read-only
     }
     
-// zero out the entire address space, to zero the unitialized data segment 
-// and the stack segment
-    bzero(machine->mainMemory, size);
+// zero out our frames, to zero the unitialized data segment and the 
+// stack segment; the rest of memory belongs to other programs
+    for (i = 0; i < numPages; i++) {
+	bzero(&(machine->mainMemory[pageTable[i].physicalPage * PageSize]),
+	      PageSize);
+	machine->ResetFrame(pageTable[i].physicalPage);
+					// we are writing behind the 
+					// simulator's back
+    }
 
 // then, copy in the code and data segments into memory
     if (noffH.code.size > 0) {
         DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
 			noffH.code.virtualAddr, noffH.code.size);
-        executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr]),
-			noffH.code.size, noffH.code.inFileAddr);
+	Load(executable, noffH.code.virtualAddr, noffH.code.size,
+	     noffH.code.inFileAddr);
     }
     if (noffH.initData.size > 0) {
         DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
 			noffH.initData.virtualAddr, noffH.initData.size);
-        executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr]),
-			noffH.initData.size, noffH.initData.inFileAddr);
+	Load(executable, noffH.initData.virtualAddr, noffH.initData.size,
+	     noffH.initData.inFileAddr);
     }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Load
+// 	Copy a segment of the executable into the address space, a page
+//	at a time, since consecutive virtual pages needn't be in
+//	consecutive frames.  The segment needn't start or end on a page
+//	boundary.
+//
+//	"executable" is the file containing the object code
+//	"virtualAddr" is where the segment goes in the address space
+//	"size" is how many bytes it has
+//	"inFileAddr" is where it is in the file
+//----------------------------------------------------------------------
 
+void
+AddrSpace::Load(OpenFile *executable, int virtualAddr, int size, 
+		int inFileAddr)
+{
+    int offset, chunk, physAddr;
+
+    ASSERT(virtualAddr >= 0 
+		&& (unsigned int) (virtualAddr + size) <= numPages * PageSize);
+    while (size > 0) {
+	offset = virtualAddr % PageSize;
+	chunk = PageSize - offset;		// the rest of this page,
+	if (chunk > size)			// or of the segment
+	    chunk = size;
+	physAddr = pageTable[virtualAddr / PageSize].physicalPage * PageSize
+								+ offset;
+	executable->ReadAt(&(machine->mainMemory[physAddr]), chunk, 
+			   inFileAddr);
+	virtualAddr += chunk;
+	inFileAddr += chunk;
+	size -= chunk;
+    }
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, giving its page frames back.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+   scheduler->ForgetSpace(this);
+   for (unsigned int i = 0; i < numPages; i++)
+	frameMap->Clear(pageTable[i].physicalPage);
+   delete [] pageTable;
 }
 
 //----------------------------------------------------------------------
@@ -183,4 +231,5 @@ void AddrSpace::RestoreState()
 {
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+    machine->FlushSoftTLB();
 }
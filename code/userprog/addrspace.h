@@ -2,7 +2,9 @@
 //	Data structures to keep track of executing user programs 
 //	(address spaces).
 //
-//	For now, we don't keep any information about address spaces.
+//	Each address space has its own page table, mapping its pages to
+//	page frames wherever there were free ones (see frameMap, in
+//	system.h), so several programs can be in memory at once.
 //	The user level CPU state is saved and restored in the thread
 //	executing the user program (see thread.h).
 //
@@ -36,6 +38,10 @@ class AddrSpace {
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+
+    void Load(OpenFile *executable, int virtualAddr, int size, 
+	      int inFileAddr);		// Copy part of the executable into
+					// the address space, page by page
 };
 
 #endif // ADDRSPACE_H
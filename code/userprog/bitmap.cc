@@ -89,16 +89,24 @@ BitMap::Test(int which)
 //	(In other words, find and allocate a bit.)
 //
 //	If no bits are clear, return -1.
+//
+//	Words with every bit set are skipped whole, so that finding a
+//	free page frame stays cheap when most of a large memory is in use.
 //----------------------------------------------------------------------
 
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
-	}
+    for (int w = 0; w < numWords; w++) {
+	if (map[w] == ~0U)
+	    continue;			// all in use
+	for (int i = w * BitsInWord; i < (w + 1) * BitsInWord && i < numBits;
+									i++)
+	    if (!Test(i)) {
+		Mark(i);
+		return i;
+	    }
+    }
     return -1;
 }
 
@@ -35,8 +35,9 @@ StartProcess(char *filename)
 
     delete executable;			// close file
 
+    scheduler->RestoreUserState();	// take over the registers, and load
+					// the page table register
     space->InitRegisters();		// set the initial register values
-    space->RestoreState();		// load page table register
 
     machine->Run();			// jump to the user progam
     ASSERT(FALSE);			// machine->Run never returns;